@@ -0,0 +1,290 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MemoryDatabaseController.h"
+
+#include <thread>
+
+namespace MyFamily
+{
+
+typedef BaseLib::Database::DataColumn DataColumn;
+
+MemoryDatabaseController::Statistics MemoryDatabaseController::getStatistics()
+{
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	return _statistics;
+}
+
+void MemoryDatabaseController::wait()
+{
+	int64_t latency = _latency;
+	if(latency > 0) std::this_thread::sleep_for(std::chrono::microseconds(latency));
+}
+
+std::shared_ptr<BaseLib::Database::DataTable> MemoryDatabaseController::toTable(const std::map<uint64_t, Row>& rows)
+{
+	std::shared_ptr<BaseLib::Database::DataTable> table = std::make_shared<BaseLib::Database::DataTable>();
+	uint32_t index = 0;
+	for(auto& row : rows)
+	{
+		table->emplace(index++, row.second);
+	}
+	return table;
+}
+
+// {{{ Device
+std::shared_ptr<BaseLib::Database::DataTable> MemoryDatabaseController::getDevices(uint32_t family)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	_statistics.reads++;
+	std::map<uint64_t, Row> devices;
+	for(auto& device : _devices)
+	{
+		if(device.second.at(4)->intValue == family) devices.emplace(device.first, device.second);
+	}
+	return toTable(devices);
+}
+
+void MemoryDatabaseController::deleteDevice(uint64_t id)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	_statistics.writes += _devices.erase(id);
+}
+
+uint64_t MemoryDatabaseController::saveDevice(uint64_t id, int32_t address, std::string& serialNumber, uint32_t type, uint32_t family)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	if(id == 0) id = _nextId++;
+	Row& row = _devices[id];
+	row[0] = std::make_shared<DataColumn>((int64_t)id);
+	row[1] = std::make_shared<DataColumn>((int64_t)address);
+	row[2] = std::make_shared<DataColumn>(serialNumber);
+	row[3] = std::make_shared<DataColumn>((int64_t)type);
+	row[4] = std::make_shared<DataColumn>((int64_t)family);
+	_statistics.writes++;
+	return id;
+}
+
+void MemoryDatabaseController::deletePeers(int32_t deviceID)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	for(auto peer = _peers.begin(); peer != _peers.end();)
+	{
+		if(peer->second.peer.at(1)->intValue != deviceID)
+		{
+			++peer;
+			continue;
+		}
+		for(auto& parameter : peer->second.parameters) _parameterPeers.erase(parameter.first);
+		for(auto& variable : peer->second.variables) _variablePeers.erase(variable.first);
+		_statistics.writes += 1 + peer->second.parameters.size() + peer->second.variables.size();
+		peer = _peers.erase(peer);
+	}
+}
+
+std::shared_ptr<BaseLib::Database::DataTable> MemoryDatabaseController::getPeers(uint64_t deviceID)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	_statistics.reads++;
+	std::map<uint64_t, Row> peers;
+	for(auto& peer : _peers)
+	{
+		if((uint64_t)peer.second.peer.at(1)->intValue == deviceID) peers.emplace(peer.first, peer.second.peer);
+	}
+	return toTable(peers);
+}
+// }}}
+
+// {{{ Peer
+void MemoryDatabaseController::deletePeer(uint64_t id)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	auto peer = _peers.find(id);
+	if(peer == _peers.end()) return;
+	for(auto& parameter : peer->second.parameters) _parameterPeers.erase(parameter.first);
+	for(auto& variable : peer->second.variables) _variablePeers.erase(variable.first);
+	_statistics.writes += 1 + peer->second.parameters.size() + peer->second.variables.size();
+	_peers.erase(peer);
+}
+
+uint64_t MemoryDatabaseController::savePeer(uint64_t id, uint32_t parentID, int32_t address, std::string& serialNumber, uint32_t type)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	if(id == 0) id = _nextId++;
+	Row& row = _peers[id].peer;
+	row[0] = std::make_shared<DataColumn>((int64_t)id);
+	row[1] = std::make_shared<DataColumn>((int64_t)parentID);
+	row[2] = std::make_shared<DataColumn>((int64_t)address);
+	row[3] = std::make_shared<DataColumn>(serialNumber);
+	row[4] = std::make_shared<DataColumn>((int64_t)type);
+	_statistics.writes++;
+	return id;
+}
+
+void MemoryDatabaseController::saveRow(BaseLib::Database::DataRow& data, bool variable)
+{
+	//Rows are "ID, peer ID, key columns..., value columns". Parameters have 5 key columns (set type, channel, remote peer,
+	//remote channel, name) and one value, variables one key column (index) and three values (integer, string, binary).
+	const size_t columnCount = variable ? 6 : 8;
+	const size_t keyEnd = variable ? 3 : 7;
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	std::map<uint64_t, uint64_t>& rowPeers = variable ? _variablePeers : _parameterPeers;
+	if(data.size() == 2)
+	{
+		//Update of the value of an existing row: value, ID
+		uint64_t id = data.at(1)->intValue;
+		auto rowPeer = rowPeers.find(id);
+		if(rowPeer == rowPeers.end()) return;
+		PeerRows& peerRows = _peers.at(rowPeer->second);
+		Row& row = (variable ? peerRows.variables : peerRows.parameters).at(id);
+		if(!variable) row[7] = data.at(0);
+		else if(data.at(0)->dataType == DataColumn::DataType::Enum::TEXT) row[4] = data.at(0);
+		else if(data.at(0)->dataType == DataColumn::DataType::Enum::BLOB) row[5] = data.at(0);
+		else row[3] = data.at(0);
+		_statistics.writes++;
+		return;
+	}
+
+	//Insert, with or without a leading ID column. Like "INSERT OR REPLACE", a row with the same key is replaced.
+	if(data.size() != columnCount && data.size() != columnCount - 1) return;
+	size_t offset = data.size() == columnCount ? 0 : 1;
+	uint64_t peerId = data.at(1 - offset)->intValue;
+	auto peer = _peers.find(peerId);
+	if(peer == _peers.end()) return;
+	std::map<uint64_t, Row>& rows = variable ? peer->second.variables : peer->second.parameters;
+	uint64_t id = 0;
+	for(auto& row : rows)
+	{
+		bool sameKey = true;
+		for(size_t i = 2; i < keyEnd && sameKey; i++)
+		{
+			const std::shared_ptr<DataColumn>& column = data.at(i - offset);
+			sameKey = row.second.at(i)->intValue == column->intValue && row.second.at(i)->textValue == column->textValue;
+		}
+		if(sameKey)
+		{
+			id = row.first;
+			break;
+		}
+	}
+	if(id == 0)
+	{
+		id = _nextId++;
+		rowPeers[id] = peerId;
+	}
+	Row& row = rows[id];
+	row[0] = std::make_shared<DataColumn>((int64_t)id);
+	for(size_t i = 1; i < columnCount; i++)
+	{
+		row[i] = data.at(i - offset);
+	}
+	_statistics.writes++;
+}
+
+void MemoryDatabaseController::savePeerParameterAsynchronous(BaseLib::Database::DataRow& data)
+{
+	wait();
+	saveRow(data, false);
+}
+
+void MemoryDatabaseController::saveSpecialPeerParameterAsynchronous(BaseLib::Database::DataRow& data)
+{
+	wait();
+	saveRow(data, false);
+}
+
+void MemoryDatabaseController::savePeerVariableAsynchronous(BaseLib::Database::DataRow& data)
+{
+	wait();
+	saveRow(data, true);
+}
+
+std::shared_ptr<BaseLib::Database::DataTable> MemoryDatabaseController::getPeerParameters(uint64_t peerID)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	_statistics.reads++;
+	auto peer = _peers.find(peerID);
+	if(peer == _peers.end()) return std::make_shared<BaseLib::Database::DataTable>();
+	return toTable(peer->second.parameters);
+}
+
+std::shared_ptr<BaseLib::Database::DataTable> MemoryDatabaseController::getPeerVariables(uint64_t peerID)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	_statistics.reads++;
+	auto peer = _peers.find(peerID);
+	if(peer == _peers.end()) return std::make_shared<BaseLib::Database::DataTable>();
+	return toTable(peer->second.variables);
+}
+
+void MemoryDatabaseController::deletePeerParameter(uint64_t peerID, BaseLib::Database::DataRow& data)
+{
+	//Only used for links, which RTS peers don't have.
+	wait();
+}
+
+bool MemoryDatabaseController::setPeerID(uint64_t oldPeerID, uint64_t newPeerID)
+{
+	wait();
+	std::lock_guard<std::mutex> tablesGuard(_tablesMutex);
+	auto peer = _peers.find(oldPeerID);
+	if(peer == _peers.end() || _peers.find(newPeerID) != _peers.end()) return false;
+	PeerRows peerRows = std::move(peer->second);
+	_peers.erase(peer);
+	peerRows.peer[0] = std::make_shared<DataColumn>((int64_t)newPeerID);
+	for(auto& parameter : peerRows.parameters)
+	{
+		parameter.second[1] = std::make_shared<DataColumn>((int64_t)newPeerID);
+		_parameterPeers[parameter.first] = newPeerID;
+	}
+	for(auto& variable : peerRows.variables)
+	{
+		variable.second[1] = std::make_shared<DataColumn>((int64_t)newPeerID);
+		_variablePeers[variable.first] = newPeerID;
+	}
+	_statistics.writes += 1 + peerRows.parameters.size() + peerRows.variables.size();
+	_peers.emplace(newPeerID, std::move(peerRows));
+	if(newPeerID >= _nextId) _nextId = newPeerID + 1;
+	return true;
+}
+// }}}
+
+}
@@ -0,0 +1,150 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef MEMORYDATABASECONTROLLER_H_
+#define MEMORYDATABASECONTROLLER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace MyFamily
+{
+
+/**
+ * Keeps the device, peer, parameter and variable tables used by the module in memory, so the central can be benchmarked
+ * without Homegear's database. Every call to these tables waits for the configured latency first, including the
+ * asynchronous writes, which Homegear queues to its database thread. The rest of the interface isn't used by the module
+ * and does nothing.
+ */
+class MemoryDatabaseController : public BaseLib::Database::IDatabaseController
+{
+public:
+	struct Statistics
+	{
+		uint64_t reads = 0;
+		uint64_t writes = 0; //Rows inserted, updated or deleted
+	};
+
+	MemoryDatabaseController() {}
+	virtual ~MemoryDatabaseController() {}
+
+	void setLatency(std::chrono::microseconds latency) { _latency = latency.count(); }
+	Statistics getStatistics();
+
+	// {{{ General
+	virtual void dispose() {}
+	virtual void init() {}
+	virtual void open(std::string databasePath, std::string databaseFilename, bool databaseSynchronous, bool databaseMemoryJournal, bool databaseWALJournal, std::string backupPath = "", std::string backupFilename = "") {}
+	virtual void hotBackup() {}
+	virtual bool isOpen() { return true; }
+	virtual void initializeDatabase() {}
+	virtual bool convertDatabase() { return false; }
+	virtual void createSavepointSynchronous(std::string& name) {}
+	virtual void releaseSavepointSynchronous(std::string& name) {}
+	virtual void createSavepointAsynchronous(std::string& name) {}
+	virtual void releaseSavepointAsynchronous(std::string& name) {}
+	// }}}
+
+	// {{{ Homegear variables
+	virtual bool getHomegearVariableString(BaseLib::Database::HomegearVariables::Enum id, std::string& value) { return false; }
+	virtual void setHomegearVariableString(BaseLib::Database::HomegearVariables::Enum id, std::string& value) {}
+	// }}}
+
+	// {{{ Family
+	virtual void deleteFamily(int32_t familyId) {}
+	virtual void saveFamilyVariableAsynchronous(int32_t familyId, BaseLib::Database::DataRow& data) {}
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getFamilyVariables(int32_t familyId) { return std::make_shared<BaseLib::Database::DataTable>(); }
+	virtual void deleteFamilyVariable(BaseLib::Database::DataRow& data) {}
+	// }}}
+
+	// {{{ Device
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getDevices(uint32_t family);
+	virtual void deleteDevice(uint64_t id);
+	virtual uint64_t saveDevice(uint64_t id, int32_t address, std::string& serialNumber, uint32_t type, uint32_t family);
+	virtual void saveDeviceVariableAsynchronous(BaseLib::Database::DataRow& data) {}
+	virtual void deletePeers(int32_t deviceID);
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getPeers(uint64_t deviceID);
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getDeviceVariables(uint64_t deviceID) { return std::make_shared<BaseLib::Database::DataTable>(); }
+	// }}}
+
+	// {{{ Peer
+	virtual void deletePeer(uint64_t id);
+	virtual uint64_t savePeer(uint64_t id, uint32_t parentID, int32_t address, std::string& serialNumber, uint32_t type);
+	virtual void savePeerParameterAsynchronous(BaseLib::Database::DataRow& data);
+	virtual void saveSpecialPeerParameterAsynchronous(BaseLib::Database::DataRow& data);
+	virtual void savePeerVariableAsynchronous(BaseLib::Database::DataRow& data);
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getPeerParameters(uint64_t peerID);
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getPeerVariables(uint64_t peerID);
+	virtual void deletePeerParameter(uint64_t peerID, BaseLib::Database::DataRow& data);
+	virtual bool setPeerID(uint64_t oldPeerID, uint64_t newPeerID);
+	// }}}
+
+	// {{{ Service messages
+	virtual std::shared_ptr<BaseLib::Database::DataTable> getServiceMessages(uint64_t peerID) { return std::make_shared<BaseLib::Database::DataTable>(); }
+	virtual void saveServiceMessageAsynchronous(uint64_t peerID, BaseLib::Database::DataRow& data) {}
+	virtual void deleteServiceMessage(uint64_t databaseID) {}
+	// }}}
+private:
+	typedef std::map<uint32_t, std::shared_ptr<BaseLib::Database::DataColumn>> Row;
+
+	//The rows of the peer's parameters and variables by their database ID, as returned by getPeerParameters() and getPeerVariables()
+	struct PeerRows
+	{
+		Row peer;
+		std::map<uint64_t, Row> parameters;
+		std::map<uint64_t, Row> variables;
+	};
+
+	std::atomic<int64_t> _latency{0}; //Microseconds
+	std::mutex _tablesMutex;
+	Statistics _statistics;
+	uint64_t _nextId = 1;
+	std::map<uint64_t, Row> _devices;
+	std::map<uint64_t, PeerRows> _peers;
+	std::map<uint64_t, uint64_t> _parameterPeers; //Peer ID by parameter ID, for updates only passing the parameter ID
+	std::map<uint64_t, uint64_t> _variablePeers; //Peer ID by variable ID
+
+	/**
+	 * Waits for the latency. Called before _tablesMutex is locked, so concurrent calls wait in parallel like with a real database.
+	 */
+	void wait();
+
+	static std::shared_ptr<BaseLib::Database::DataTable> toTable(const std::map<uint64_t, Row>& rows);
+	void saveRow(BaseLib::Database::DataRow& data, bool variable);
+};
+
+}
+
+#endif
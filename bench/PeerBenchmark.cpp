@@ -0,0 +1,319 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "MemoryDatabaseController.h"
+#include "../src/GD.h"
+#include "../src/MyCentral.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace MyFamily
+{
+
+/**
+ * Makes the peer operations of the central callable without RPC clients or the CLI.
+ */
+class BenchmarkCentral : public MyCentral
+{
+public:
+	BenchmarkCentral(uint32_t deviceId, std::string serialNumber, ICentralEventSink* eventHandler) : MyCentral(deviceId, serialNumber, eventHandler) {}
+
+	using MyCentral::loadPeers;
+	using MyCentral::savePeers;
+	using MyCentral::deletePeer;
+
+	std::vector<uint64_t> getPeerIds()
+	{
+		std::vector<uint64_t> ids;
+		std::lock_guard<std::mutex> peersGuard(_peersMutex);
+		ids.reserve(_peersById.size());
+		for(auto& peer : _peersById) ids.push_back(peer.first);
+		return ids;
+	}
+
+	/**
+	 * Makes savePeers() write every peer instead of only the changed ones.
+	 */
+	void markAllChanged()
+	{
+		std::lock_guard<std::mutex> peersGuard(_peersMutex);
+		for(auto& peerIterator : _peersById)
+		{
+			std::shared_ptr<MyPeer> peer(std::dynamic_pointer_cast<MyPeer>(peerIterator.second));
+			if(peer) peer->markChanged();
+		}
+	}
+};
+
+/**
+ * Hides the messages of the module, e. g. one "Added peer" per peer, while a scenario runs.
+ */
+class QuietOutput
+{
+public:
+	QuietOutput() : _buffer(std::cout.rdbuf(nullptr)) {}
+	~QuietOutput() { std::cout.rdbuf(_buffer); }
+private:
+	std::streambuf* _buffer;
+};
+
+class PeerBenchmark
+{
+public:
+	PeerBenchmark(std::shared_ptr<MemoryDatabaseController> db, uint32_t deviceType) : _db(db), _deviceType(deviceType)
+	{
+		_clientInfo = std::make_shared<BaseLib::RpcClientInfo>();
+		_addressStep = deviceType == MyPeer::DeviceType::rtsMultiRemote ? 16 : 1;
+	}
+
+	/**
+	 * Creates the peers through createDevice(), the way RPC clients pair them.
+	 *
+	 * @return Returns false if a peer could not be created.
+	 */
+	bool createPeers(BenchmarkCentral& central, int32_t first, int32_t count)
+	{
+		for(int32_t i = first; i < first + count; i++)
+		{
+			int32_t address = (0x100000 + i * _addressStep) & 0xFFFFFF;
+			PVariable result = central.createDevice(_clientInfo, _deviceType, "", address, 0, "");
+			if(result->errorStruct)
+			{
+				std::cerr << "Could not create peer " << i << ": " << result->structValue->at("faultString")->stringValue << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Returns the resident memory of the process in bytes or -1 on error.
+	 */
+	static int64_t getResidentSetSize()
+	{
+		//Pages of the whole process: total, resident, ...
+		std::ifstream statm("/proc/self/statm");
+		int64_t size = 0;
+		int64_t resident = 0;
+		if(!(statm >> size >> resident)) return -1;
+		return resident * sysconf(_SC_PAGESIZE);
+	}
+
+	/**
+	 * Returns the bytes allocated on the heap. Unlike the resident memory it doesn't depend on memory freed before being reused.
+	 */
+	static int64_t getHeapInUse()
+	{
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+		struct mallinfo2 info = mallinfo2();
+#else
+		struct mallinfo info = mallinfo();
+#endif
+		return (int64_t)info.uordblks + (int64_t)info.hblkhd;
+	}
+
+	void printHeader()
+	{
+		std::string bar(" │ ");
+		std::cout << std::setfill(' ') << std::left
+			<< std::setw(8) << "Scenario" << bar
+			<< std::setw(8) << "Peers" << bar
+			<< std::setw(10) << "Total ms" << bar
+			<< std::setw(12) << "Per peer µs" << bar
+			<< std::setw(9) << "DB reads" << bar
+			<< "DB writes" << std::endl;
+	}
+
+	void startScenario()
+	{
+		_statistics = _db->getStatistics();
+		_startTime = std::chrono::steady_clock::now();
+	}
+
+	void endScenario(const std::string& name, size_t peers)
+	{
+		int64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _startTime).count();
+		MemoryDatabaseController::Statistics statistics = _db->getStatistics();
+		std::string bar(" │ ");
+		std::cout
+			<< std::setw(8) << name << bar
+			<< std::setw(8) << peers << bar
+			<< std::setw(10) << duration / 1000 << bar
+			<< std::setw(12) << (peers == 0 ? std::string("-") : std::to_string(duration / (int64_t)peers)) << bar
+			<< std::setw(9) << statistics.reads - _statistics.reads << bar
+			<< statistics.writes - _statistics.writes << std::endl;
+	}
+private:
+	std::shared_ptr<MemoryDatabaseController> _db;
+	uint32_t _deviceType = MyPeer::DeviceType::rtsSwitch;
+	int32_t _addressStep = 1;
+	BaseLib::PRpcClientInfo _clientInfo;
+	MemoryDatabaseController::Statistics _statistics;
+	std::chrono::steady_clock::time_point _startTime;
+};
+
+}
+
+void printHelp()
+{
+	std::cout << "Usage: somfy_bench [OPTIONS]" << std::endl << std::endl;
+	std::cout << "Runs the peer operations of the central against an in-memory database." << std::endl << std::endl;
+	std::cout << "Option              Meaning" << std::endl;
+	std::cout << "-h                  Show this help" << std::endl;
+	std::cout << "-c <path>           Homegear's configuration directory with \"main.conf\", which points to the device descriptions. Default: /etc/homegear/" << std::endl;
+	std::cout << "-l <microseconds>   Latency of every database call. Default: 0" << std::endl;
+	std::cout << "-n <count>          Peers in the database before loading. Default: 10000" << std::endl;
+	std::cout << "-t <type>           Device type. 1 (default) for a single remote, 2 for a remote with 16 channels." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		std::string configPath = "/etc/homegear/";
+		int64_t latency = 0;
+		int32_t peerCount = 10000;
+		const int32_t createCount = 1000;
+		const int32_t deleteCount = 500;
+		uint32_t deviceType = MyFamily::MyPeer::DeviceType::rtsSwitch;
+
+		int option = 0;
+		while((option = getopt(argc, argv, "hc:l:n:t:")) != -1)
+		{
+			std::string argument(optarg ? optarg : "");
+			switch(option)
+			{
+			case 'c':
+				configPath = argument;
+				if(!configPath.empty() && configPath.back() != '/') configPath.push_back('/');
+				break;
+			case 'l':
+				latency = BaseLib::Math::getNumber64(argument);
+				break;
+			case 'n':
+				peerCount = BaseLib::Math::getNumber(argument);
+				break;
+			case 't':
+				deviceType = BaseLib::Math::getNumber(argument);
+				break;
+			default:
+				printHelp();
+				return option == 'h' ? 0 : 1;
+			}
+		}
+		if(latency < 0 || peerCount < deleteCount || (deviceType != MyFamily::MyPeer::DeviceType::rtsSwitch && deviceType != MyFamily::MyPeer::DeviceType::rtsMultiRemote))
+		{
+			printHelp();
+			return 1;
+		}
+
+		std::string executablePath(argv[0]);
+		executablePath = executablePath.substr(0, executablePath.find_last_of('/') + 1);
+		std::unique_ptr<BaseLib::SharedObjects> bl(new BaseLib::SharedObjects());
+		bl->settings.load(configPath + "main.conf", executablePath);
+		//Installed before the family and the central are created, so everything they load or save ends up in memory.
+		std::shared_ptr<MyFamily::MemoryDatabaseController> db = std::make_shared<MyFamily::MemoryDatabaseController>();
+		bl->db = db;
+
+		std::unique_ptr<MyFamily::MyFamily> family(new MyFamily::MyFamily(bl.get(), nullptr));
+		MyFamily::PeerBenchmark benchmark(db, deviceType);
+
+		std::cout << "Filling the database with " << peerCount << " peers..." << std::endl;
+		{
+			MyFamily::QuietOutput quietOutput;
+			MyFamily::BenchmarkCentral central(1, "VRTS0000001", family.get());
+			if(!benchmark.createPeers(central, 0, peerCount)) return 1;
+		}
+
+		//The latency only applies to the scenarios.
+		db->setLatency(std::chrono::microseconds(latency));
+		std::cout << "Database latency: " << latency << " µs" << std::endl << std::endl;
+		benchmark.printHeader();
+
+		MyFamily::BenchmarkCentral central(1, "VRTS0000001", family.get());
+		//The database already holds all rows, so what the load allocates is what the peers keep in memory.
+		int64_t heapBefore = MyFamily::PeerBenchmark::getHeapInUse();
+		{
+			MyFamily::QuietOutput quietOutput;
+			benchmark.startScenario();
+			central.loadPeers();
+		}
+		size_t loadedPeers = central.getPeerIds().size();
+		benchmark.endScenario("Load", loadedPeers);
+		int64_t heapAfterLoad = MyFamily::PeerBenchmark::getHeapInUse();
+
+		bool created = false;
+		{
+			MyFamily::QuietOutput quietOutput;
+			benchmark.startScenario();
+			created = benchmark.createPeers(central, peerCount, createCount);
+		}
+		if(!created) return 1;
+		benchmark.endScenario("Create", createCount);
+
+		size_t savedPeers = central.getPeerIds().size();
+		central.markAllChanged();
+		{
+			MyFamily::QuietOutput quietOutput;
+			benchmark.startScenario();
+			central.savePeers(true);
+		}
+		benchmark.endScenario("Save", savedPeers);
+
+		std::vector<uint64_t> peerIds = central.getPeerIds();
+		{
+			MyFamily::QuietOutput quietOutput;
+			benchmark.startScenario();
+			for(int32_t i = 0; i < deleteCount; i++) central.deletePeer(peerIds.at(i));
+		}
+		benchmark.endScenario("Delete", deleteCount);
+
+
+		std::cout << std::endl;
+		if(loadedPeers > 0) std::cout << "Memory of the loaded peers: " << (heapAfterLoad - heapBefore) / 1024 << " KiB, per 1000 peers: " << (heapAfterLoad - heapBefore) * 1000 / (int64_t)loadedPeers / 1024 << " KiB" << std::endl;
+		int64_t resident = MyFamily::PeerBenchmark::getResidentSetSize();
+		if(resident < 0) std::cout << "Could not read the memory usage from /proc/self/statm." << std::endl;
+		else std::cout << "Resident memory of the process: " << resident / 1024 << " KiB, including the in-memory database" << std::endl;
+
+		central.dispose();
+		family->dispose();
+		return 0;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << "Error: " << ex.what() << std::endl;
+	}
+	return 1;
+}
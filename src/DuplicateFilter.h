@@ -0,0 +1,140 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef DUPLICATEFILTER_H_
+#define DUPLICATEFILTER_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace MyFamily
+{
+
+/**
+ * Remembers the RTS frames received during the last few seconds, so a frame heard by several interfaces (or repeated
+ * by the remote while a button is held) is only processed once. The first copy is kept, later ones are dropped. Frames are identified by address and rolling code.
+ *
+ * The table has a fixed size and uses open addressing. Each slot holds identity and reception time in one word, so
+ * slots are claimed with a single compare-and-swap and no lock is needed. Slots older than the window are reused. When
+ * all slots probed for a frame are in use, the frame is not recorded and is treated as new.
+ */
+class DuplicateFilter
+{
+public:
+	DuplicateFilter()
+	{
+		for(auto& slot : _slots)
+		{
+			slot.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @param address The 24 bit RTS address.
+	 * @param rollingCode The rolling code of the frame.
+	 * @param time The current time in milliseconds (e. g. HelperFunctions::getTime()).
+	 * @param window Frames received within this many milliseconds after the previous copy are duplicates. Must be
+	 * below 2^23 ms.
+	 * @return Returns true if the frame was already received within the window.
+	 */
+	bool isDuplicate(uint32_t address, uint16_t rollingCode, int64_t time, int64_t window)
+	{
+		uint64_t key = (((uint64_t)address & 0xFFFFFF) << 16) | rollingCode;
+		uint64_t entry = (key << timeBits) | ((uint64_t)time & timeMask);
+		size_t start = hash(key);
+		while(true)
+		{
+			size_t freeIndex = slotCount;
+			uint64_t freeSlot = 0;
+			//All probed slots are checked for the frame first: Slots in front of it might have expired meanwhile.
+			for(size_t i = 0; i < maxProbes; i++)
+			{
+				size_t index = (start + i) & (slotCount - 1);
+				uint64_t slot = _slots[index].load(std::memory_order_acquire);
+				bool expired = slot == 0 || age(slot, time) >= window;
+				if(!expired && (slot >> timeBits) == key)
+				{
+					//Remotes repeat the frame while a button is held, so the window restarts with every copy.
+					_slots[index].compare_exchange_strong(slot, entry, std::memory_order_acq_rel);
+					_duplicates.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+				if(expired && freeIndex == slotCount)
+				{
+					freeIndex = index;
+					freeSlot = slot;
+				}
+			}
+			if(freeIndex == slotCount)
+			{
+				_overflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			//When another thread took the slot first, it might have been for the same frame, so check again.
+			if(_slots[freeIndex].compare_exchange_strong(freeSlot, entry, std::memory_order_acq_rel)) return false;
+		}
+	}
+
+	uint64_t getDuplicateCount() { return _duplicates.load(std::memory_order_relaxed); }
+
+	/**
+	 * The number of frames that couldn't be recorded, because all probed slots were in use.
+	 */
+	uint64_t getOverflowCount() { return _overflows.load(std::memory_order_relaxed); }
+private:
+	static const size_t slotCount = 512; //Must be a power of two
+	static const size_t maxProbes = 8;
+	static const uint64_t timeBits = 24;
+	static const uint64_t timeMask = (1ull << timeBits) - 1;
+
+	//Bits 0 to 23: reception time in milliseconds (wraps after about 4.6 hours), bits 24 to 39: rolling code, bits 40 to
+	//63: address. 0 marks an unused slot.
+	std::array<std::atomic<uint64_t>, slotCount> _slots;
+	std::atomic<uint64_t> _duplicates{0};
+	std::atomic<uint64_t> _overflows{0};
+
+	static size_t hash(uint64_t key)
+	{
+		key *= 0x9E3779B97F4A7C15ull;
+		return (size_t)(key >> 32) & (slotCount - 1);
+	}
+
+	static int64_t age(uint64_t slot, int64_t time)
+	{
+		return (int64_t)(((uint64_t)time - slot) & timeMask);
+	}
+};
+
+}
+
+#endif
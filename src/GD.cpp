@@ -36,5 +36,21 @@ namespace MyFamily
 	MyFamily* GD::family = nullptr;
 	std::map<std::string, std::shared_ptr<ISomfyInterface>> GD::physicalInterfaces;
 	std::shared_ptr<ISomfyInterface> GD::defaultPhysicalInterface;
+	std::shared_ptr<Reactor> GD::reactor;
+	std::shared_ptr<StrandExecutor> GD::commandExecutor;
 	BaseLib::Output GD::out;
+	bool GD::supersedeProg = false;
+	int32_t GD::frameAirtime = 0;
+	int32_t GD::dutyCycleReserve = 25;
+	int32_t GD::maxQueuedPackets = 0;
+	int32_t GD::maxQueueDelay = 30000;
+	bool GD::rejectWhileDisconnected = false;
+	int32_t GD::probeInterval = 60000;
+	int32_t GD::probeTimeout = 2000;
+	int32_t GD::degradedLatency = 1000;
+	int32_t GD::shutdownTimeout = 5000;
+	bool GD::autoSelectInterface = false;
+	int32_t GD::interfaceSelectionMargin = 6;
+	int32_t GD::duplicateWindow = 2000;
+	std::atomic_bool GD::shuttingDown{false};
 }
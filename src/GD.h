@@ -37,6 +37,8 @@
 #include <homegear-base/BaseLib.h>
 #include "MyFamily.h"
 #include "PhysicalInterfaces/ISomfyInterface.h"
+#include "PhysicalInterfaces/Reactor.h"
+#include "StrandExecutor.h"
 
 namespace MyFamily
 {
@@ -50,7 +52,27 @@ public:
 	static MyFamily* family;
 	static std::map<std::string, std::shared_ptr<ISomfyInterface>> physicalInterfaces;
 	static std::shared_ptr<ISomfyInterface> defaultPhysicalInterface;
+	static std::shared_ptr<Reactor> reactor;
+	static std::shared_ptr<StrandExecutor> commandExecutor;
 	static BaseLib::Output out;
+
+	//From the "General" section of "somfy.conf"
+	static bool supersedeProg;
+	static int32_t frameAirtime;
+	static int32_t dutyCycleReserve;
+	static int32_t maxQueuedPackets;
+	static int32_t maxQueueDelay;
+	static bool rejectWhileDisconnected;
+	static int32_t probeInterval;
+	static int32_t probeTimeout;
+	static int32_t degradedLatency;
+	static int32_t shutdownTimeout;
+	static bool autoSelectInterface;
+	static int32_t interfaceSelectionMargin;
+	static int32_t duplicateWindow;
+
+	//Set when Homegear shuts down. New commands are rejected from then on.
+	static std::atomic_bool shuttingDown;
 	enum packetType { INTERTECHNO, CULTX };
 private:
 	GD();
@@ -0,0 +1,96 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "InterfaceSelector.h"
+
+namespace MyFamily
+{
+
+void InterfaceSelector::rssiReceived(const std::string& interfaceId, int32_t rssi, int64_t time)
+{
+	if(rssi == 0) return; //RSSI reporting ("X21") is off
+	std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+	Statistics& statistics = _statistics[interfaceId];
+	//Exponentially weighted, so single outliers (e. g. a remote held next to the stick) don't dominate.
+	statistics.rssi = statistics.frames == 0 ? rssi : statistics.rssi + (rssi - statistics.rssi) / 4;
+	statistics.lastRssi = rssi;
+	statistics.frames++;
+	statistics.lastFrame = time;
+}
+
+int32_t InterfaceSelector::getLastRssi(const std::string& interfaceId)
+{
+	std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+	auto statisticsIterator = _statistics.find(interfaceId);
+	return statisticsIterator == _statistics.end() ? 0 : statisticsIterator->second.lastRssi;
+}
+
+std::map<std::string, InterfaceSelector::Statistics> InterfaceSelector::getStatistics()
+{
+	std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+	return _statistics;
+}
+
+InterfaceSelector::Selection InterfaceSelector::select(const std::string& currentId, bool currentUsable, const std::function<bool(const std::string& interfaceId)>& usable, int64_t time, int32_t margin)
+{
+	Selection selection;
+	std::string bestId;
+	double bestRssi = 0;
+	{
+		std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+		for(auto& statistics : _statistics)
+		{
+			//Too few or too old frames don't tell much about the current situation.
+			if(statistics.second.frames < minFrames || time - statistics.second.lastFrame > maxFrameAge) continue;
+			if(!usable(statistics.first)) continue;
+			if(statistics.first == currentId)
+			{
+				selection.currentRssi = statistics.second.rssi;
+				selection.currentKnown = true;
+			}
+			if(bestId.empty() || statistics.second.rssi > bestRssi)
+			{
+				bestId = statistics.first;
+				bestRssi = statistics.second.rssi;
+			}
+		}
+	}
+	if(bestId.empty() || bestId == currentId) return selection;
+	//Without frames received by the current interface there is nothing to compare with, unless it doesn't work at all.
+	if(!selection.currentKnown && currentUsable) return selection;
+	//Interfaces receiving the peer about equally well would otherwise take turns.
+	if(selection.currentKnown && bestRssi < selection.currentRssi + margin) return selection;
+	selection.interfaceId = bestId;
+	selection.rssi = bestRssi;
+	return selection;
+}
+
+}
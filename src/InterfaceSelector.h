@@ -0,0 +1,107 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef INTERFACESELECTOR_H_
+#define INTERFACESELECTOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace MyFamily
+{
+
+/**
+ * Keeps the signal strength of the frames received from one peer's part of the installation per interface and picks
+ * the interface hearing it best. An interface is only considered with at least minFrames frames received within
+ * maxFrameAge, and only replaces the current one when it is at least "margin" dB better.
+ */
+class InterfaceSelector
+{
+public:
+	struct Statistics
+	{
+		double rssi = 0; //Smoothed, in dBm
+		int32_t lastRssi = 0;
+		uint64_t frames = 0;
+		int64_t lastFrame = 0;
+	};
+
+	struct Selection
+	{
+		std::string interfaceId; //Empty if the current interface is kept
+		double rssi = 0;
+		bool currentKnown = false; //Whether the current interface received enough frames to compare with
+		double currentRssi = 0;
+	};
+
+	static const uint64_t minFrames = 3;
+	static const int64_t maxFrameAge = 86400000;
+
+	InterfaceSelector() = default;
+	virtual ~InterfaceSelector() = default;
+
+	/**
+	 * Adds a frame received by an interface.
+	 *
+	 * @param rssi The signal strength in dBm. 0 means unknown and is ignored.
+	 * @param time The time of reception in milliseconds.
+	 */
+	void rssiReceived(const std::string& interfaceId, int32_t rssi, int64_t time);
+
+	/**
+	 * Returns the signal strength of the last frame received by the interface, 0 if unknown.
+	 */
+	int32_t getLastRssi(const std::string& interfaceId);
+
+	std::map<std::string, Statistics> getStatistics();
+
+	/**
+	 * Returns the interface to switch to.
+	 *
+	 * @param currentId The interface used now.
+	 * @param currentUsable False if the current interface doesn't exist or failed. Without frames received by the current
+	 * interface, the peer only switches if it isn't usable.
+	 * @param usable Returns false for interfaces that must not be selected, e. g. failed ones.
+	 * @param time The current time in milliseconds.
+	 * @param margin See "interfaceSelectionMargin" in "somfy.conf".
+	 */
+	Selection select(const std::string& currentId, bool currentUsable, const std::function<bool(const std::string& interfaceId)>& usable, int64_t time, int32_t margin);
+private:
+	std::mutex _statisticsMutex;
+	std::map<std::string, Statistics> _statistics; //By interface ID
+};
+
+}
+
+#endif
@@ -31,7 +31,7 @@
 #include "Interfaces.h"
 #include "GD.h"
 #include "PhysicalInterfaces/Cul.h"
-//#include "PhysicalInterfaces/Coc.h"
+#include "PhysicalInterfaces/Coc.h"
 #include "PhysicalInterfaces/Cunx.h"
 //#include "PhysicalInterfaces/TiCc1100.h"
 
@@ -45,12 +45,16 @@ Interfaces::Interfaces(BaseLib::SharedObjects* bl, std::map<std::string, Systems
 
 Interfaces::~Interfaces()
 {
+	if(GD::reactor) GD::reactor->stop();
 }
 
 void Interfaces::create()
 {
 	try
 	{
+		if(!GD::reactor) GD::reactor = std::make_shared<Reactor>();
+		int32_t reactorThreadPriority = -1;
+		int32_t reactorThreadPolicy = SCHED_OTHER;
 		for(std::map<std::string, Systems::PPhysicalInterfaceSettings>::iterator i = _physicalInterfaceSettings.begin(); i != _physicalInterfaceSettings.end(); ++i)
 		{
 			std::shared_ptr<ISomfyInterface> device;
@@ -61,6 +65,7 @@ void Interfaces::create()
 			else */
 			if(i->second->type == "cunx") device.reset(new Cunx(i->second));
 			else if(i->second->type == "cul") device.reset(new Cul(i->second));
+			else if(i->second->type == "coc") device.reset(new Coc(i->second));
 /*#ifdef SPISUPPORT
 			else if(i->second->type == "cc1100") device.reset(new TiCc1100(i->second));
 #endif*/
@@ -71,8 +76,15 @@ void Interfaces::create()
 				_physicalInterfaces[i->second->id] = device;
 				GD::physicalInterfaces[i->second->id] = device;
 				if(i->second->isDefault || !GD::defaultPhysicalInterface) GD::defaultPhysicalInterface = device;
+				//All interfaces are served by one thread, which runs with the highest priority configured.
+				if(i->second->listenThreadPriority > reactorThreadPriority)
+				{
+					reactorThreadPriority = i->second->listenThreadPriority;
+					reactorThreadPolicy = i->second->listenThreadPolicy;
+				}
 			}
 		}
+		GD::reactor->start(reactorThreadPriority, reactorThreadPolicy);
 		if(!GD::defaultPhysicalInterface) GD::defaultPhysicalInterface = std::make_shared<ISomfyInterface>(std::make_shared<BaseLib::Systems::PhysicalInterfaceSettings>());
 	}
 	catch(const std::exception& ex)
@@ -0,0 +1,143 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LOGGING_H_
+#define LOGGING_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <atomic>
+
+namespace MyFamily
+{
+
+/**
+ * Limits how often a log line is printed. Used for lines that can be triggered by every frame (e. g. "LOVF" or
+ * sending while disconnected).
+ */
+class LogRateLimiter
+{
+public:
+	/**
+	 * @param interval The minimum time in milliseconds between two printed lines.
+	 */
+	explicit LogRateLimiter(int64_t interval = 10000) : _interval(interval) {}
+
+	/**
+	 * @param[out] suppressed The number of lines suppressed since the last line that was allowed.
+	 * @return Returns true when the line should be printed.
+	 */
+	bool allow(uint32_t& suppressed)
+	{
+		int64_t time = BaseLib::HelperFunctions::getTime();
+		int64_t nextAllowed = _nextAllowed.load();
+		if(time < nextAllowed || !_nextAllowed.compare_exchange_strong(nextAllowed, time + _interval))
+		{
+			_suppressed++;
+			return false;
+		}
+		suppressed = _suppressed.exchange(0);
+		return true;
+	}
+private:
+	const int64_t _interval;
+	std::atomic<int64_t> _nextAllowed{0};
+	std::atomic<uint32_t> _suppressed{0};
+};
+
+/**
+ * Level-gated logging for hot paths. The message is passed as a callable (usually a lambda) which is only invoked
+ * when the current debug level prints the message, so no strings are built for lines that are discarded anyway.
+ *
+ * Example:
+ *   Logging::info(_out, [&]() { return "Info: Sending: " + packet->culHexString(); });
+ */
+class Logging
+{
+public:
+	struct Level
+	{
+		enum Enum : int32_t
+		{
+			critical = 1,
+			error = 2,
+			warning = 3,
+			info = 4,
+			debug = 5
+		};
+	};
+
+	static bool enabled(int32_t level);
+
+	template<typename MessageFunction> static void error(BaseLib::Output& out, MessageFunction message)
+	{
+		if(enabled(Level::Enum::error)) out.printError(message());
+	}
+
+	template<typename MessageFunction> static void warning(BaseLib::Output& out, MessageFunction message)
+	{
+		if(enabled(Level::Enum::warning)) out.printWarning(message());
+	}
+
+	template<typename MessageFunction> static void warning(BaseLib::Output& out, LogRateLimiter& limiter, MessageFunction message)
+	{
+		if(!enabled(Level::Enum::warning)) return;
+		uint32_t suppressed = 0;
+		if(!limiter.allow(suppressed)) return;
+		if(suppressed == 0) out.printWarning(message());
+		else out.printWarning(message() + " (" + std::to_string(suppressed) + " similar messages suppressed)");
+	}
+
+	template<typename MessageFunction> static void info(BaseLib::Output& out, MessageFunction message)
+	{
+		if(enabled(Level::Enum::info)) out.printInfo(message());
+	}
+
+	template<typename MessageFunction> static void info(BaseLib::Output& out, LogRateLimiter& limiter, MessageFunction message)
+	{
+		if(!enabled(Level::Enum::info)) return;
+		uint32_t suppressed = 0;
+		if(!limiter.allow(suppressed)) return;
+		if(suppressed == 0) out.printInfo(message());
+		else out.printInfo(message() + " (" + std::to_string(suppressed) + " similar messages suppressed)");
+	}
+
+	template<typename MessageFunction> static void debug(BaseLib::Output& out, MessageFunction message, int32_t level = Level::Enum::debug)
+	{
+		if(enabled(level)) out.printDebug(message(), level);
+	}
+private:
+	Logging() = delete;
+};
+
+}
+
+#endif
@@ -30,7 +30,10 @@
 
 #include "MyCentral.h"
 #include "GD.h"
+#include "Logging.h"
 
+#include <algorithm>
+#include <fstream>
 #include <iomanip>
 
 namespace MyFamily {
@@ -50,12 +53,54 @@ MyCentral::~MyCentral()
 	dispose();
 }
 
+void MyCentral::homegearShuttingDown()
+{
+	try
+	{
+		int64_t startTime = BaseLib::HelperFunctions::getTime();
+		//From here on ISomfyInterface::admit() rejects new commands.
+		GD::shuttingDown = true;
+		//Commands accepted before are processed to the end, so their packets are queued and their rolling codes saved.
+		if(GD::commandExecutor) GD::commandExecutor->stop();
+
+		//All queues are written in parallel by the reactor, so waiting for one after the other doesn't add up.
+		int64_t deadline = startTime + GD::shutdownTimeout;
+		TransmitQueue::DrainResult total;
+		for(auto& interface : GD::physicalInterfaces)
+		{
+			TransmitQueue::DrainResult result = interface.second->drain(deadline);
+			total.sent += result.sent;
+			total.dropped += result.dropped;
+			if(result.dropped > 0) GD::out.printWarning("Warning: Dropped " + std::to_string(result.dropped) + " packets queued for interface " + interface.first + ".");
+		}
+
+		//The peers write their rolling codes once more, see MyPeer::homegearShuttingDown().
+		size_t peerCount = 0;
+		{
+			std::lock_guard<std::mutex> peersGuard(_peersMutex);
+			peerCount = _peersById.size();
+		}
+		ICentral::homegearShuttingDown();
+
+		GD::out.printInfo("Info: Shutdown: Sent " + std::to_string(total.sent) + " queued packets, dropped " + std::to_string(total.dropped) + ", saved the rolling codes of " + std::to_string(peerCount) + " peers in " + std::to_string(BaseLib::HelperFunctions::getTime() - startTime) + " ms.");
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
 void MyCentral::dispose(bool wait)
 {
 	try
 	{
 		if(_disposing) return;
 		_disposing = true;
+		{
+			std::lock_guard<std::mutex> replayThreadGuard(_replayThreadMutex);
+			stopReplay();
+		}
+
 		GD::out.printDebug("Removing device " + std::to_string(_deviceId) + " from physical device's event queue...");
 		for(std::map<std::string, std::shared_ptr<ISomfyInterface>>::iterator i = GD::physicalInterfaces.begin(); i != GD::physicalInterfaces.end(); ++i)
 		{
@@ -80,6 +125,10 @@ void MyCentral::init()
 		{
 			_physicalInterfaceEventhandlers[i->first] = i->second->addEventHandler((BaseLib::Systems::IPhysicalInterface::IPhysicalInterfaceEventSink*)this);
 		}
+
+		_localRpcMethods.emplace("getInterfaceHealth", std::bind(&MyCentral::getInterfaceHealth, this, std::placeholders::_1, std::placeholders::_2));
+		_localRpcMethods.emplace("exportPeers", std::bind(&MyCentral::exportPeers, this, std::placeholders::_1, std::placeholders::_2));
+		_localRpcMethods.emplace("importPeers", std::bind(&MyCentral::importPeers, this, std::placeholders::_1, std::placeholders::_2));
 	}
 	catch(const std::exception& ex)
 	{
@@ -91,11 +140,14 @@ void MyCentral::loadPeers()
 {
 	try
 	{
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		size_t loadedPeers = 0;
 		std::shared_ptr<BaseLib::Database::DataTable> rows = _bl->db->getPeers(_deviceId);
 		for(BaseLib::Database::DataTable::iterator row = rows->begin(); row != rows->end(); ++row)
 		{
 			int32_t peerID = row->second.at(0)->intValue;
-			GD::out.printMessage("Loading Somfy peer " + std::to_string(peerID));
+			//One line per peer at the default log level adds up with thousands of peers.
+			Logging::debug(GD::out, [&]() { return "Debug: Loading Somfy peer " + std::to_string(peerID); });
 			std::shared_ptr<MyPeer> peer(new MyPeer(peerID, row->second.at(2)->intValue, row->second.at(3)->textValue, _deviceId, this));
 			if(!peer->load(this)) continue;
 			if(!peer->getRpcDevice()) continue;
@@ -103,7 +155,11 @@ void MyCentral::loadPeers()
 			if(!peer->getSerialNumber().empty()) _peersBySerial[peer->getSerialNumber()] = peer;
 			_peersById[peerID] = peer;
 			_peers[peer->getAddress()] = peer;
+			_remoteAddressIndex.set(peerID, peer->getRemoteAddresses());
+			loadedPeers++;
 		}
+		addOperationTime(PeerOperation::load, loadedPeers, startTime);
+		GD::out.printMessage("Loaded " + std::to_string(loadedPeers) + " Somfy peers in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count()) + " ms.");
 	}
 	catch(const std::exception& ex)
     {
@@ -147,6 +203,34 @@ std::shared_ptr<MyPeer> MyCentral::getPeer(int32_t address)
     return std::shared_ptr<MyPeer>();
 }
 
+bool MyCentral::addressesInUse(int32_t address, uint32_t count)
+{
+	try
+	{
+		//Multi-channel remotes occupy one address per channel, so ranges are compared instead of looking up "_peers".
+		//Addresses have 24 bits. The distances are taken modulo 2^24, so ranges wrapping around 0xFFFFFF are compared correctly.
+		std::lock_guard<std::mutex> peersGuard(_peersMutex);
+		for(auto& peerIterator : _peersById)
+		{
+			std::shared_ptr<MyPeer> peer(std::dynamic_pointer_cast<MyPeer>(peerIterator.second));
+			if(!peer) continue;
+			uint32_t peerAddress = (uint32_t)peer->getAddress();
+			if((((uint32_t)address - peerAddress) & 0xFFFFFF) < peer->getAddressCount() || ((peerAddress - (uint32_t)address) & 0xFFFFFF) < count) return true;
+		}
+	}
+	catch(const std::exception& ex)
+    {
+        GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return false;
+}
+
+bool MyCentral::addressRangeValid(int32_t address, uint32_t count)
+{
+	//The channels of a multi-channel remote must not wrap around to address 0.
+	return address >= 0 && (int64_t)address + count <= 0x1000000;
+}
+
 std::shared_ptr<MyPeer> MyCentral::getPeer(std::string serialNumber)
 {
 	try
@@ -168,131 +252,491 @@ std::shared_ptr<MyPeer> MyCentral::getPeer(std::string serialNumber)
 
 bool MyCentral::onPacketReceived(std::string& senderId, std::shared_ptr<BaseLib::Systems::Packet> packet)
 {
+	try
+	{
 		if(_disposing) return false;
-/*
-		if(packet->getTag() == GD::INTERTECHNO) {
-			auto receivedPacket = std::dynamic_pointer_cast<MyPacket>(packet);
-			if(!receivedPacket) return false;
-			return processPacket(senderId,receivedPacket);
+		std::shared_ptr<MyPacket> myPacket(std::dynamic_pointer_cast<MyPacket>(packet));
+		if(!myPacket) return false;
+		return processPacket(senderId, myPacket);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void MyCentral::setRemoteAddresses(uint64_t peerId, const std::vector<int32_t>& addresses)
+{
+	_remoteAddressIndex.set(peerId, addresses);
+}
+
+bool MyCentral::processPacket(const std::string& senderId, std::shared_ptr<MyPacket> myPacket)
+{
+	try
+	{
+		//Frames with a peer's address are sent by this module or, if the peer was imported from one, a physical remote with
+		//the same address. Physical remotes paired with the same motors have their own addresses, listed in the peer's
+		//REMOTE_ADDRESSES. Frames from remotes tell how well the receiving interface hears that part of the installation.
+		int32_t address = myPacket->senderAddress();
+		std::vector<std::shared_ptr<MyPeer>> peers;
+		std::shared_ptr<MyPeer> peer;
+		{
+			//Multi-channel remotes use up to 16 consecutive addresses starting at the peer's address.
+			std::lock_guard<std::mutex> peersGuard(_peersMutex);
+			for(int32_t i = 0; i < 16 && i <= address; i++)
+			{
+				auto peerIterator = _peers.find(address - i);
+				if(peerIterator == _peers.end()) continue;
+				std::shared_ptr<MyPeer> candidate(std::dynamic_pointer_cast<MyPeer>(peerIterator->second));
+				if(candidate && (int64_t)address < (int64_t)candidate->getAddress() + candidate->getAddressCount())
+				{
+					peer = candidate;
+					break;
+				}
+			}
+		}
+		if(peer)
+		{
+			//The sending interface never receives these, the others only tell how well they hear it, so they would skew the selection.
+			if(peer->isOwnFrame(address, myPacket->getRollingCode()))
+			{
+				Logging::debug(GD::out, [&]() { return "Debug: Ignoring frame " + std::to_string(myPacket->getRollingCode()) + " from 0x" + BaseLib::HelperFunctions::getHexString(address, 6) + " sent by this module and received by " + senderId + "."; });
+				return true;
+			}
+			peers.push_back(peer);
+		}
+		for(uint64_t peerId : _remoteAddressIndex.find(address))
+		{
+			std::shared_ptr<MyPeer> remotePeer = getPeer(peerId);
+			if(remotePeer && remotePeer != peer) peers.push_back(remotePeer);
+		}
+		if(peers.empty()) return false;
+
+		//Every copy tells how well its interface receives the peers, but the frame itself is only processed once.
+		for(auto& receivingPeer : peers)
+		{
+			receivingPeer->rssiReceived(senderId, myPacket);
+		}
+		if(_duplicateFilter.isDuplicate(address, myPacket->getRollingCode(), myPacket->timeReceived(), GD::duplicateWindow))
+		{
+			Logging::debug(GD::out, [&]() { return "Debug: Ignoring duplicate of frame " + std::to_string(myPacket->getRollingCode()) + " from 0x" + BaseLib::HelperFunctions::getHexString(address, 6) + " received by " + senderId + "."; });
+			return true;
 		}
 
-		if(packet->getTag() == GD::CULTX) {
-			auto receivedPacket = std::dynamic_pointer_cast<MyCulTxPacket>(packet);
-			if(!receivedPacket) return false;
-			return processPacket(senderId,receivedPacket);
+		//Saving RSSI_DEVICE and switching the interface must not block the reactor or race commands being sent.
+		for(auto& receivingPeer : peers)
+		{
+			if(!GD::commandExecutor->post(receivingPeer->getStrand(), [receivingPeer, senderId, myPacket]() { receivingPeer->frameReceived(senderId, myPacket); })) receivingPeer->frameReceived(senderId, myPacket);
 		}
-*/
-		return false;
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
 }
 
-bool MyCentral::processPacket(const std::string& senderId, std::shared_ptr<MyPacket> myPacket)
+void MyCentral::stopReplay()
+{
+	{
+		std::lock_guard<std::mutex> replayStopGuard(_replayStopMutex);
+		_stopReplay = true;
+	}
+	_replayStopConditionVariable.notify_all();
+	_bl->threadManager.join(_replayThread);
+}
+
+size_t MyCentral::writePeerExport(std::ostream& output)
+{
+	try
+	{
+		std::vector<std::shared_ptr<MyPeer>> peers;
+		{
+			std::lock_guard<std::mutex> peersGuard(_peersMutex);
+			peers.reserve(_peersById.size());
+			for(auto& peerIterator : _peersById)
+			{
+				std::shared_ptr<MyPeer> peer(std::dynamic_pointer_cast<MyPeer>(peerIterator.second));
+				if(peer) peers.push_back(peer);
+			}
+		}
+
+		output << "# Somfy RTS peers: ADDRESS TYPE ROLLING_CODE KEY INTERFACE CHANNEL_CODES NAME" << '\n';
+		for(auto& peer : peers)
+		{
+			std::string channelCodes;
+			std::vector<RollingCode::Value> codes = peer->getRemoteChannelCodes();
+			for(auto& code : codes)
+			{
+				if(!channelCodes.empty()) channelCodes.push_back(',');
+				channelCodes.append(BaseLib::HelperFunctions::getHexString((int32_t)code.rollingCode, 4) + ':' + BaseLib::HelperFunctions::getHexString((int32_t)code.encryptionKey, 2));
+			}
+			std::string interfaceId = peer->getAssignedPhysicalInterfaceId();
+			std::string name = peer->getName();
+			std::replace(name.begin(), name.end(), '\n', ' ');
+			output << BaseLib::HelperFunctions::getHexString(peer->getAddress(), 6) << ' '
+				<< peer->getDeviceType() << ' '
+				<< BaseLib::HelperFunctions::getHexString((int32_t)peer->getRollingCode(), 4) << ' '
+				<< BaseLib::HelperFunctions::getHexString((int32_t)peer->getEncryptionKey(), 2) << ' '
+				<< (interfaceId.empty() ? "-" : interfaceId) << ' '
+				<< (channelCodes.empty() ? "-" : channelCodes) << ' '
+				<< name << '\n';
+		}
+		output.flush();
+		return peers.size();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return 0;
+}
+
+bool MyCentral::readPeerImport(std::istream& input, ImportResult& result, std::string& error)
 {
-/*
 	try
 	{
+		struct Record
+		{
+			uint32_t line = 0;
+			int32_t address = 0;
+			uint32_t addressCount = 1;
+			RollingCode::Value code;
+			std::vector<RollingCode::Value> channelCodes;
+			std::string interfaceId;
+			std::string name;
+			bool interfaceUnknown = false; //The peer uses the default interface then
+			std::shared_ptr<MyPeer> peer;
+			bool exists = false;
+			//State of an existing peer before the import, restored if writing fails
+			RollingCode::Value previousCode;
+			std::vector<RollingCode::Value> previousChannelCodes;
+			std::string previousInterfaceId;
+			std::string previousName;
+		};
 
-		if(GD::bl->debugLevel >= 4) _bl->out.printInfo(BaseLib::HelperFunctions::getTimeString(myPacket->getTimeReceived()) + " Somfy packet received from " + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress(), 8) + " (RSSI: " + std::to_string(((int32_t)myPacket->getRssi()) * -1) + " dBm): " + myPacket->getPayload());
+		auto parseHex = [](const std::string& text, uint32_t maxValue, uint32_t& value) -> bool
+		{
+			if(text.empty() || text.size() > 8 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) return false;
+			value = std::stoul(text, nullptr, 16);
+			return value <= maxValue;
+		};
+		auto parseCode = [&](const std::string& text, RollingCode::Value& code) -> bool
+		{
+			std::string::size_type separator = text.find(':');
+			uint32_t rollingCode = 0;
+			uint32_t key = 0;
+			if(separator == std::string::npos || !parseHex(text.substr(0, separator), 0xFFFF, rollingCode) || !parseHex(text.substr(separator + 1), 0xFF, key)) return false;
+			code.rollingCode = rollingCode;
+			code.encryptionKey = key;
+			return true;
+		};
 
-		if(myPacket->getPayload().find('F') != std::string::npos)
+		//{{{ Check everything before the first peer is touched
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		//Address ranges of the paired peers, sorted by start. Calling addressesInUse() for every line would be quadratic.
+		std::vector<std::pair<int64_t, int64_t>> usedRanges;
 		{
-			std::vector<std::shared_ptr<BaseLib::Systems::Peer>> peers = getPeers();
-			for(auto peer : peers)
+			std::lock_guard<std::mutex> peersGuard(_peersMutex);
+			usedRanges.reserve(_peersById.size());
+			for(auto& peerIterator : _peersById)
+			{
+				std::shared_ptr<MyPeer> peer(std::dynamic_pointer_cast<MyPeer>(peerIterator.second));
+				if(!peer) continue;
+				int64_t end = (int64_t)peer->getAddress() + peer->getAddressCount();
+				usedRanges.emplace_back(peer->getAddress(), end);
+				//Peers paired before ranges wrapping around 0xFFFFFF were rejected also occupy the addresses from 0.
+				if(end > 0x1000000) usedRanges.emplace_back(0, end - 0x1000000);
+			}
+		}
+		std::sort(usedRanges.begin(), usedRanges.end());
+		auto rangeInUse = [&](int64_t start, int64_t end) -> bool
+		{
+			//The range starting last before "end" is the only one that can overlap, as ranges of paired peers don't overlap.
+			auto rangeIterator = std::lower_bound(usedRanges.begin(), usedRanges.end(), std::make_pair(end, (int64_t)0));
+			return rangeIterator != usedRanges.begin() && std::prev(rangeIterator)->second > start;
+		};
+		std::vector<Record> records;
+		std::vector<std::string> errors;
+		std::string line;
+		uint32_t lineNumber = 0;
+		while(std::getline(input, line) && errors.size() < 10)
+		{
+			lineNumber++;
+			BaseLib::HelperFunctions::trim(line);
+			if(line.empty() || line.front() == '#') continue;
+
+			std::istringstream lineStream(line);
+			std::string address, type, rollingCode, key, interfaceId, channelCodes;
+			if(!(lineStream >> address >> type >> rollingCode >> key >> interfaceId >> channelCodes))
 			{
-				PMyPeer myPeer = std::dynamic_pointer_cast<MyPeer>(peer);
-				if(senderId != myPeer->getPhysicalInterfaceId()) return false;
-				if(myPeer->getDeviceType() == 0x24) //Elro
+				errors.push_back("Line " + std::to_string(lineNumber) + ": Expected at least 6 fields.");
+				continue;
+			}
+
+			Record record;
+			record.line = lineNumber;
+			uint32_t value = 0;
+			uint32_t deviceType = 0;
+			if(!parseHex(address, 0xFFFFFF, value))
+			{
+				errors.push_back("Line " + std::to_string(lineNumber) + ": Invalid address.");
+				continue;
+			}
+			record.address = value;
+			if(!type.empty() && type.size() <= 9 && type.find_first_not_of("0123456789") == std::string::npos) deviceType = std::stoul(type);
+			if(deviceType == 0 || !GD::family->getRpcDevice(deviceType, 0x10))
+			{
+				errors.push_back("Line " + std::to_string(lineNumber) + ": Unknown device type.");
+				continue;
+			}
+			if(!parseCode(rollingCode + ':' + key, record.code))
+			{
+				errors.push_back("Line " + std::to_string(lineNumber) + ": Invalid rolling code or key.");
+				continue;
+			}
+			if(interfaceId != "-")
+			{
+				if(GD::physicalInterfaces.find(interfaceId) != GD::physicalInterfaces.end()) record.interfaceId = interfaceId;
+				else record.interfaceUnknown = true;
+			}
+			if(channelCodes != "-")
+			{
+				std::vector<std::string> codes = BaseLib::HelperFunctions::splitAll(channelCodes, ',');
+				record.channelCodes.resize(codes.size());
+				bool valid = true;
+				for(size_t i = 0; i < codes.size() && valid; i++)
 				{
-					if(myPeer->getAddress() == (myPacket->senderAddress() >> 5))
-					{
-						int32_t channel = (~myPacket->senderAddress()) & 0x1F;
-						switch(channel)
-						{
-						case 1:
-							channel = 5;
-							break;
-						case 2:
-							channel = 4;
-							break;
-						case 4:
-							channel = 3;
-							break;
-						case 8:
-							channel = 2;
-							break;
-						case 16:
-							channel = 1;
-							break;
-						default:
-							channel = 0;
-						}
-						myPacket->setChannel(channel);
-						myPeer->packetReceived(myPacket);
-						break;
-					}
+					valid = parseCode(codes[i], record.channelCodes[i]);
 				}
-				else if(myPeer->getDeviceType() == 0x30) //Old Somfy 1 channel sensor
+				if(!valid)
 				{
-					if(myPeer->getAddress() == (myPacket->senderAddress() >> 2))
-					{
-						myPacket->setChannel(1);
-						myPeer->packetReceived(myPacket);
-						break;
-					}
+					errors.push_back("Line " + std::to_string(lineNumber) + ": Invalid channel codes.");
+					continue;
 				}
-				else if(myPeer->getDeviceType() == 0x33) //Old Somfy remote
-				{
-					std::pair<int32_t, int32_t> startCodeAndChannel = getOldItGroupStartCodeAndChannel(myPacket->senderAddress());
+			}
+			std::getline(lineStream, record.name);
+			BaseLib::HelperFunctions::trim(record.name);
 
-					if(myPeer->getAddress() == (((myPacket->senderAddress() & 0x3C0) >> 2) | startCodeAndChannel.first))
-					{
-						myPacket->setChannel(startCodeAndChannel.second);
-						myPeer->packetReceived(myPacket);
-						break;
-					}
+			record.peer = getPeer(record.address);
+			if(record.peer && record.peer->getDeviceType() == deviceType) record.exists = true;
+			else if(record.peer)
+			{
+				errors.push_back("Line " + std::to_string(lineNumber) + ": A peer of another type is paired with this address.");
+				continue;
+			}
+			else
+			{
+				//Not saved yet, so nothing is written before all lines were checked.
+				record.peer = createPeer(deviceType, record.address, "RTS" + BaseLib::HelperFunctions::getHexString(record.address, 6), false);
+				if(!record.peer || !record.peer->getRpcDevice())
+				{
+					errors.push_back("Line " + std::to_string(lineNumber) + ": Unknown device type.");
+					continue;
+				}
+				if(!addressRangeValid(record.address, record.peer->getAddressCount()))
+				{
+					errors.push_back("Line " + std::to_string(lineNumber) + ": The address range of this peer exceeds 0xFFFFFF.");
+					continue;
 				}
-				else
-                {
-				    if(GD::bl->debugLevel >= 4) _bl->out.printInfo(BaseLib::HelperFunctions::getTimeString(myPacket->getTimeReceived()) + " Please use one of the following addresses for device creation: Somfy multi-channel remote or sensor (use device type 0x33): 0x" + BaseLib::HelperFunctions::getHexString(((myPacket->senderAddress() & 0x3C0) >> 2) | getOldItGroupStartCodeAndChannel(myPacket->senderAddress()).first, 4) + "; Somfy one channel remote or sensor (use device type 0x30): 0x" + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress() >> 2, 4) + "; Elro (use device type 0x24): 0x" + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress() >> 5, 4));
-                }
+				if(rangeInUse(record.address, (int64_t)record.address + record.peer->getAddressCount()))
+				{
+					errors.push_back("Line " + std::to_string(lineNumber) + ": An address in the range of this peer is already in use.");
+					continue;
+				}
+			}
+			record.addressCount = record.peer->getAddressCount();
+			if(!record.channelCodes.empty() && record.channelCodes.size() != record.addressCount)
+			{
+				errors.push_back("Line " + std::to_string(lineNumber) + ": Expected " + std::to_string(record.addressCount) + " channel codes.");
+				continue;
 			}
+			records.push_back(std::move(record));
+		}
 
-			if(peers.empty() && GD::bl->debugLevel >= 4) _bl->out.printInfo(BaseLib::HelperFunctions::getTimeString(myPacket->getTimeReceived()) + " Please use one of the following addresses for device creation: Somfy multi-channel remote or sensor (use device type 0x33): 0x" + BaseLib::HelperFunctions::getHexString(((myPacket->senderAddress() & 0x3C0) >> 2) | getOldItGroupStartCodeAndChannel(myPacket->senderAddress()).first, 4) + "; Somfy one channel remote or sensor (use device type 0x30): 0x" + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress() >> 2, 4) + "; Elro (use device type 0x24): 0x" + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress() >> 5, 4));
+		//Lines must not use overlapping addresses either.
+		std::vector<Record*> sortedRecords;
+		sortedRecords.reserve(records.size());
+		for(auto& record : records)
+		{
+			sortedRecords.push_back(&record);
 		}
-		else
+		std::sort(sortedRecords.begin(), sortedRecords.end(), [](const Record* a, const Record* b) { return a->address < b->address; });
+		for(size_t i = 1; i < sortedRecords.size() && errors.size() < 10; i++)
+		{
+			if((int64_t)sortedRecords[i - 1]->address + sortedRecords[i - 1]->addressCount > sortedRecords[i]->address) errors.push_back("Line " + std::to_string(sortedRecords[i]->line) + ": The address range overlaps the one of line " + std::to_string(sortedRecords[i - 1]->line) + ".");
+		}
+
+		if(!errors.empty())
 		{
-			PMyPeer peer = getPeer(myPacket->senderAddress());
-			if(!peer)
+			error.clear();
+			for(auto& message : errors)
 			{
-				peer = getPeer((int32_t)(0x80000000 | myPacket->senderAddress()));
-				if(!peer)
-                {
-					if(GD::bl->debugLevel >= 4) _bl->out.printInfo(BaseLib::HelperFunctions::getTimeString(myPacket->getTimeReceived()) + " Please use one of the following addresses for device creation (possible device types: 0x10 to 0x1F): 0x" + BaseLib::HelperFunctions::getHexString(myPacket->senderAddress(), 8) + " or 0x" + BaseLib::HelperFunctions::getHexString((int32_t)(0x80000000 | myPacket->senderAddress()), 8));
-                    return false;
-                }
+				error.append(message + '\n');
 			}
-			if(senderId != peer->getPhysicalInterfaceId()) return false;
+			if(errors.size() >= 10) error.append("Stopped after 10 errors.\n");
+			return false;
+		}
+		//}}}
+
+		std::vector<uint64_t> newIds;
+		newIds.reserve(records.size());
+		PVariable deviceDescriptions = std::make_shared<Variable>(VariableType::tArray);
+		//All writes of the import go into one transaction.
+		std::string savepointName("SomfyPeerImport");
+		_bl->db->createSavepointSynchronous(savepointName);
+		size_t writtenRecords = 0;
+		try
+		{
+			for(auto& record : records)
+			{
+				writtenRecords++;
+				std::shared_ptr<MyPeer>& peer = record.peer;
+				if(record.interfaceUnknown) result.defaultInterface++;
+				if(record.exists)
+				{
+					record.previousCode.rollingCode = peer->getRollingCode();
+					record.previousCode.encryptionKey = peer->getEncryptionKey();
+					record.previousChannelCodes = peer->getRemoteChannelCodes();
+					record.previousInterfaceId = peer->getAssignedPhysicalInterfaceId();
+					record.previousName = peer->getName();
+					if(!record.interfaceId.empty() && peer->getAssignedPhysicalInterfaceId() != record.interfaceId) peer->setPhysicalInterfaceId(record.interfaceId);
+					peer->setRollingCode(record.code.rollingCode, record.code.encryptionKey);
+					if(!record.channelCodes.empty()) peer->setRemoteChannelCodes(record.channelCodes);
+					if(!record.name.empty() && peer->getName() != record.name) peer->setName(record.name);
+					result.updated++;
+					continue;
+				}
 
-			peer->packetReceived(myPacket);
+				peer->save(true, true, false);
+				peer->initializeCentralConfig();
+				peer->setPhysicalInterfaceId(record.interfaceId);
+				peer->setRollingCode(record.code.rollingCode, record.code.encryptionKey);
+				if(!record.channelCodes.empty()) peer->setRemoteChannelCodes(record.channelCodes);
+				if(!record.name.empty()) peer->setName(record.name);
+				{
+					std::lock_guard<std::mutex> peersGuard(_peersMutex);
+					_peers[peer->getAddress()] = peer;
+					_peersById[peer->getID()] = peer;
+					_peersBySerial[peer->getSerialNumber()] = peer;
+				}
+				newIds.push_back(peer->getID());
+				PArray descriptions = peer->getDeviceDescriptions(nullptr, true, std::map<std::string, bool>());
+				if(descriptions) deviceDescriptions->arrayValue->insert(deviceDescriptions->arrayValue->end(), descriptions->begin(), descriptions->end());
+				result.created++;
+			}
 		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+			//The database API has no rollback, so the records written so far are undone by hand before the savepoint is released.
+			for(size_t i = 0; i < writtenRecords; i++)
+			{
+				Record& record = records[i];
+				if(record.exists)
+				{
+					record.peer->setRollingCode(record.previousCode.rollingCode, record.previousCode.encryptionKey);
+					if(!record.previousChannelCodes.empty()) record.peer->setRemoteChannelCodes(record.previousChannelCodes);
+					if(record.peer->getAssignedPhysicalInterfaceId() != record.previousInterfaceId) record.peer->setPhysicalInterfaceId(record.previousInterfaceId);
+					if(record.peer->getName() != record.previousName) record.peer->setName(record.previousName);
+					continue;
+				}
+				if(record.peer->getID() == 0) continue; //Not saved yet
+				{
+					std::lock_guard<std::mutex> peersGuard(_peersMutex);
+					_peersById.erase(record.peer->getID());
+					_peersBySerial.erase(record.peer->getSerialNumber());
+					auto peerIterator = _peers.find(record.peer->getAddress());
+					if(peerIterator != _peers.end() && peerIterator->second == record.peer) _peers.erase(peerIterator);
+				}
+				record.peer->deleteFromDatabase();
+			}
+			_bl->db->releaseSavepointSynchronous(savepointName);
+			result = ImportResult();
+			error = "Could not write the imported peers. Nothing was imported.";
+			return false;
+		}
+		_bl->db->releaseSavepointSynchronous(savepointName);
+		//Announced together, so clients get one event instead of one per peer.
+		if(!newIds.empty()) raiseRPCNewDevices(newIds, deviceDescriptions);
+		if(result.created > 0) addOperationTime(PeerOperation::create, result.created, startTime);
+
+		result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+		GD::out.printInfo("Info: Imported peers: " + std::to_string(result.created) + " created, " + std::to_string(result.updated) + " updated in " + std::to_string(result.duration) + " ms.");
+		return true;
 	}
 	catch(const std::exception& ex)
-    {
-        GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    }
-    */
-    return false;
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		error = "Unknown application error.";
+	}
+	return false;
+}
+
+void MyCentral::replayTraffic(std::string interfaceId, std::string filename)
+{
+	try
+	{
+		auto interfaceIterator = GD::physicalInterfaces.find(interfaceId);
+		if(interfaceIterator == GD::physicalInterfaces.end()) return;
+		ISomfyInterface::ReplayStatistics statistics;
+		auto waitUntil = [this](std::chrono::steady_clock::time_point time)
+		{
+			std::unique_lock<std::mutex> replayStopGuard(_replayStopMutex);
+			return !_replayStopConditionVariable.wait_until(replayStopGuard, time, [this]() { return _stopReplay; });
+		};
+		if(!interfaceIterator->second->replay(filename, false, statistics, waitUntil)) return;
+		GD::out.printInfo("Info: Replay of " + filename + " finished. " + std::to_string(statistics.receivedRecords) + " received records (" + std::to_string(statistics.receivedBytes) + " bytes) processed, " + std::to_string(statistics.sentRecords) + " sent records skipped.");
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
 }
 
 void MyCentral::savePeers(bool full)
 {
 	try
 	{
-		std::lock_guard<std::mutex> peersGuard(_peersMutex);
-		for(std::map<uint64_t, std::shared_ptr<BaseLib::Systems::Peer>>::iterator i = _peersById.begin(); i != _peersById.end(); ++i)
+		//Everything the peers write is saved right away as well, so only peers changed since the last pass are saved again,
+		//no matter if "full" is set. They are collected first, so the peers mutex isn't held while writing to the database.
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		std::vector<std::shared_ptr<MyPeer>> changedPeers;
+		size_t peerCount = 0;
 		{
-			GD::out.printInfo("Info: Saving Somfy peer " + std::to_string(i->second->getID()));
-			i->second->save(full, full, full);
+			std::lock_guard<std::mutex> peersGuard(_peersMutex);
+			peerCount = _peersById.size();
+			for(auto& peer : _peersById)
+			{
+				std::shared_ptr<MyPeer> myPeer = std::dynamic_pointer_cast<MyPeer>(peer.second);
+				if(myPeer && myPeer->hasChanges()) changedPeers.push_back(myPeer);
+			}
 		}
+
+		size_t savedPeers = 0;
+		if(!changedPeers.empty())
+		{
+			//One transaction for the whole pass instead of one per write.
+			std::string savepointName("SomfySavePeers");
+			_bl->db->createSavepointSynchronous(savepointName);
+			try
+			{
+				for(auto& peer : changedPeers)
+				{
+					Logging::debug(GD::out, [&]() { return "Debug: Saving Somfy peer " + std::to_string(peer->getID()); });
+					if(peer->saveChanges()) savedPeers++;
+				}
+			}
+			catch(const std::exception& ex)
+			{
+				GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+			}
+			_bl->db->releaseSavepointSynchronous(savepointName);
+		}
+		addOperationTime(PeerOperation::save, savedPeers, startTime);
+		Logging::info(GD::out, [&]() { return "Info: Saved " + std::to_string(savedPeers) + " of " + std::to_string(peerCount) + " Somfy peers."; });
 	}
 	catch(const std::exception& ex)
     {
@@ -304,6 +748,7 @@ void MyCentral::deletePeer(uint64_t id)
 {
 	try
 	{
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 		std::shared_ptr<MyPeer> peer(getPeer(id));
 		if(!peer) return;
 		peer->deleting = true;
@@ -332,6 +777,7 @@ void MyCentral::deletePeer(uint64_t id)
 			peerIterator = _peers.find(peer->getAddress());
 			if(peerIterator != _peers.end() && peerIterator->second->getID() == id) _peers.erase(peerIterator);
 		}
+		_remoteAddressIndex.remove(id);
 
 		int32_t i = 0;
 		while(peer.use_count() > 1 && i < 600)
@@ -344,6 +790,7 @@ void MyCentral::deletePeer(uint64_t id)
 		peer->deleteFromDatabase();
 
 		GD::out.printMessage("Removed Somfy peer " + std::to_string(peer->getID()));
+		addOperationTime(PeerOperation::remove, 1, startTime);
 	}
 	catch(const std::exception& ex)
     {
@@ -351,6 +798,17 @@ void MyCentral::deletePeer(uint64_t id)
     }
 }
 
+void MyCentral::addOperationTime(PeerOperation operation, size_t peers, std::chrono::steady_clock::time_point startTime)
+{
+	int64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	std::lock_guard<std::mutex> operationStatisticsGuard(_operationStatisticsMutex);
+	OperationStatistics& statistics = _operationStatistics[(int32_t)operation];
+	statistics.calls++;
+	statistics.peers += peers;
+	statistics.durationSum += duration;
+	if(duration > statistics.maxDuration) statistics.maxDuration = duration;
+}
+
 std::string MyCentral::handleCliCommand(std::string command)
 {
 	try
@@ -362,36 +820,260 @@ std::string MyCentral::handleCliCommand(std::string command)
 		{
 			stringStream << "List of commands:" << std::endl << std::endl;
 			stringStream << "For more information about the individual command type: COMMAND help" << std::endl << std::endl;
+			stringStream << "interfaces record (ir)  Records the traffic of an interface" << std::endl;
+			stringStream << "interfaces replay (ip)  Replays recorded traffic" << std::endl;
+			stringStream << "interfaces stats (is)   Shows the transmit queue counters" << std::endl;
+			stringStream << "interfaces health (ih)  Shows the health of the interfaces" << std::endl;
 			stringStream << "peers create (pc)   Creates a new peer" << std::endl;
+			stringStream << "peers export (pe)   Writes the addresses and rolling codes of all peers to a file" << std::endl;
+			stringStream << "peers import (pi)   Creates or updates peers from a file written by \"peers export\"" << std::endl;
 			stringStream << "peers list (ls)     List all peers" << std::endl;
+			stringStream << "peers timings (pt)  Shows how long loading, saving, creating and deleting peers takes" << std::endl;
 			stringStream << "peers remove (pr)   Remove a peer" << std::endl;
 			stringStream << "peers select (ps)   Select a peer" << std::endl;
 			stringStream << "peers setname (pn)  Name a peer" << std::endl;
 			stringStream << "unselect (u)        Unselect this device" << std::endl;
 			return stringStream.str();
 		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "interfaces record", "ir", "", 1, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command records everything an interface sends and receives into a binary file. Call it without FILENAME to stop recording." << std::endl;
+				stringStream << "Usage: interfaces record INTERFACE [FILENAME]" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  INTERFACE: The id of the interface as defined in the familie's configuration file." << std::endl;
+				stringStream << "  FILENAME:  The file to write the capture to. Example: /tmp/cunx.capture" << std::endl;
+				return stringStream.str();
+			}
+
+			auto interfaceIterator = GD::physicalInterfaces.find(arguments.at(0));
+			if(interfaceIterator == GD::physicalInterfaces.end()) return "Unknown physical interface.\n";
+
+			if(arguments.size() < 2)
+			{
+				if(!interfaceIterator->second->isRecording()) return "The interface is not being recorded.\n";
+				interfaceIterator->second->stopRecording();
+				stringStream << "Recording stopped." << std::endl;
+			}
+			else if(interfaceIterator->second->startRecording(arguments.at(1))) stringStream << "Recording to " << arguments.at(1) << "." << std::endl;
+			else stringStream << "Could not open " << arguments.at(1) << " for writing." << std::endl;
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "interfaces replay", "ip", "", 2, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command feeds the received data of a capture back into an interface as if the device had sent it." << std::endl;
+				stringStream << "Usage: interfaces replay INTERFACE FILENAME [SPEED]" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  INTERFACE: The id of the interface as defined in the familie's configuration file." << std::endl;
+				stringStream << "  FILENAME:  The capture written by \"interfaces record\"." << std::endl;
+				stringStream << "  SPEED:     \"original\" (default) keeps the recorded timing and replays in the background. \"max\" replays as fast as possible and prints the throughput." << std::endl;
+				return stringStream.str();
+			}
+
+			std::string interfaceId = arguments.at(0);
+			if(GD::physicalInterfaces.find(interfaceId) == GD::physicalInterfaces.end()) return "Unknown physical interface.\n";
+			std::string filename = arguments.at(1);
+			bool maxSpeed = arguments.size() > 2 && arguments.at(2) == "max";
+
+			if(!maxSpeed)
+			{
+				std::lock_guard<std::mutex> replayThreadGuard(_replayThreadMutex);
+				stopReplay();
+				{
+					std::lock_guard<std::mutex> replayStopGuard(_replayStopMutex);
+					_stopReplay = false;
+				}
+				_bl->threadManager.start(_replayThread, false, &MyCentral::replayTraffic, this, interfaceId, filename);
+				stringStream << "Replaying " << filename << " in the background. See the log for the result." << std::endl;
+				return stringStream.str();
+			}
+
+			ISomfyInterface::ReplayStatistics statistics;
+			if(!GD::physicalInterfaces.at(interfaceId)->replay(filename, true, statistics)) return "Could not replay " + filename + ". See log file for more details.\n";
+			double seconds = (double)statistics.duration / 1000000.0;
+			stringStream << "Replayed " << statistics.receivedRecords << " received records (" << statistics.receivedBytes << " bytes) in " << std::fixed << std::setprecision(3) << seconds << " s." << std::endl;
+			if(seconds > 0) stringStream << "Throughput: " << std::setprecision(0) << (statistics.receivedRecords / seconds) << " records/s, " << (statistics.receivedBytes / seconds) << " bytes/s." << std::endl;
+			stringStream << "Skipped " << statistics.sentRecords << " sent records." << std::endl;
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "interfaces stats", "is", "", 0, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command shows how many packets each interface sent, replaced by a newer packet for the same remote or dropped. Stacked interfaces share one queue and show the same numbers." << std::endl;
+				stringStream << "The latency is the time from queueing a packet to writing it to the device in milliseconds, shown separately for normal and high priority packets." << std::endl;
+				stringStream << "Usage: interfaces stats" << std::endl;
+				return stringStream.str();
+			}
+
+			auto latency = [](const TransmitQueue::LaneStatistics& lane)
+			{
+				if(lane.sent == 0) return std::string("-");
+				return std::to_string(lane.latencySum / (int64_t)lane.sent) + "/" + std::to_string(lane.maxLatency);
+			};
+			std::string bar(" │ ");
+			stringStream << std::setfill(' ') << std::left
+				<< std::setw(20) << "Interface" << bar
+				<< std::setw(10) << "Sent" << bar
+				<< std::setw(10) << "Superseded" << bar
+				<< std::setw(10) << "Dropped" << bar
+				<< std::setw(6) << "Queued" << bar
+				<< std::setw(15) << "Normal avg/max" << bar
+				<< "High avg/max" << std::endl;
+			for(auto& interface : GD::physicalInterfaces)
+			{
+				TransmitQueue::Statistics statistics = interface.second->getTransmitStatistics();
+				stringStream
+					<< std::setw(20) << interface.first << bar
+					<< std::setw(10) << statistics.sent << bar
+					<< std::setw(10) << statistics.superseded << bar
+					<< std::setw(10) << statistics.dropped << bar
+					<< std::setw(6) << statistics.queued << bar
+					<< std::setw(15) << latency(statistics.lanes[(int32_t)TransmitPriority::normal]) << bar
+					<< latency(statistics.lanes[(int32_t)TransmitPriority::high]) << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "interfaces health", "ih", "", 0, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command shows the result of the periodic version queries sent to each interface. Latency and jitter are smoothed round-trip times in milliseconds." << std::endl;
+				stringStream << "Commands to failed interfaces are rejected. Set \"probeInterval\" in \"somfy.conf\" to change how often the interfaces are queried." << std::endl;
+				stringStream << "Usage: interfaces health" << std::endl;
+				return stringStream.str();
+			}
+
+			if(GD::probeInterval <= 0) return "Probing is disabled.\n";
+			std::string bar(" │ ");
+			int64_t now = BaseLib::HelperFunctions::getTime();
+			stringStream << std::setfill(' ') << std::left
+				<< std::setw(20) << "Interface" << bar
+				<< std::setw(8) << "State" << bar
+				<< std::setw(7) << "Latency" << bar
+				<< std::setw(6) << "Jitter" << bar
+				<< std::setw(8) << "Probes" << bar
+				<< std::setw(8) << "Timeouts" << bar
+				<< "Last answer" << std::endl;
+			for(auto& interface : GD::physicalInterfaces)
+			{
+				HealthMonitor::Statistics statistics = interface.second->getHealthStatistics();
+				stringStream
+					<< std::setw(20) << interface.first << bar
+					<< std::setw(8) << HealthMonitor::getStateName(statistics.state) << bar
+					<< std::setw(7) << (int64_t)statistics.latency << bar
+					<< std::setw(6) << (int64_t)statistics.jitter << bar
+					<< std::setw(8) << statistics.probes << bar
+					<< std::setw(8) << statistics.timeouts << bar
+					<< (statistics.lastResponse == 0 ? std::string("-") : std::to_string((now - statistics.lastResponse) / 1000) + " s ago") << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "peers timings", "pt", "", 0, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command shows how long the peer operations writing to the database took since the module was loaded." << std::endl;
+				stringStream << "\"Per peer\" divides the total time by the number of peers processed, e. g. by a save pass writing only the changed peers." << std::endl;
+				stringStream << "Usage: peers timings" << std::endl;
+				return stringStream.str();
+			}
+
+			static const char* operationNames[peerOperationCount] = { "Load", "Save", "Create", "Delete" };
+			std::string bar(" │ ");
+			stringStream << std::setfill(' ') << std::left
+				<< std::setw(8) << "Action" << bar
+				<< std::setw(8) << "Calls" << bar
+				<< std::setw(8) << "Peers" << bar
+				<< std::setw(10) << "Avg ms" << bar
+				<< std::setw(10) << "Max ms" << bar
+				<< "Per peer µs" << std::endl;
+			std::lock_guard<std::mutex> operationStatisticsGuard(_operationStatisticsMutex);
+			for(size_t i = 0; i < peerOperationCount; i++)
+			{
+				OperationStatistics& statistics = _operationStatistics[i];
+				stringStream
+					<< std::setw(8) << operationNames[i] << bar
+					<< std::setw(8) << statistics.calls << bar
+					<< std::setw(8) << statistics.peers << bar
+					<< std::setw(10) << (statistics.calls == 0 ? std::string("-") : std::to_string(statistics.durationSum / (int64_t)statistics.calls / 1000)) << bar
+					<< std::setw(10) << (statistics.calls == 0 ? std::string("-") : std::to_string(statistics.maxDuration / 1000)) << bar
+					<< (statistics.peers == 0 ? std::string("-") : std::to_string(statistics.durationSum / (int64_t)statistics.peers)) << std::endl;
+			}
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "peers export", "pe", "", 1, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command writes address, type, rolling codes, keys, interface and name of all peers to a file, e. g. to move them to new hardware." << std::endl;
+				stringStream << "Usage: peers export FILENAME" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  FILENAME: The file to write. Example: /tmp/somfy.peers" << std::endl;
+				return stringStream.str();
+			}
+
+			std::ofstream output(arguments.at(0), std::ios::out | std::ios::trunc);
+			if(!output) return "Could not open " + arguments.at(0) + " for writing.\n";
+			std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+			size_t peerCount = writePeerExport(output);
+			output.close();
+			if(!output) return "Error writing " + arguments.at(0) + ".\n";
+			stringStream << "Exported " << peerCount << " peers in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() << " ms." << std::endl;
+			return stringStream.str();
+		}
+		else if(BaseLib::HelperFunctions::checkCliCommand(command, "peers import", "pi", "", 1, arguments, showHelp))
+		{
+			if(showHelp)
+			{
+				stringStream << "Description: This command creates the peers listed in a file written by \"peers export\". Peers already paired with the same address and type get the rolling codes, interface and name from the file." << std::endl;
+				stringStream << "The whole file is checked first. If any line is invalid, no peer is created or changed. Peers with an interface unknown to this installation use the default interface." << std::endl;
+				stringStream << "Usage: peers import FILENAME" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  FILENAME: The file to read. Example: /tmp/somfy.peers" << std::endl;
+				return stringStream.str();
+			}
+
+			std::ifstream input(arguments.at(0));
+			if(!input) return "Could not open " + arguments.at(0) + " for reading.\n";
+			ImportResult result;
+			std::string error;
+			if(!readPeerImport(input, result, error)) return "Nothing was imported:\n" + error;
+			stringStream << "Created " << result.created << " and updated " << result.updated << " peers in " << result.duration << " ms." << std::endl;
+			if(result.defaultInterface > 0) stringStream << result.defaultInterface << " peers use the default interface, because their interface is unknown." << std::endl;
+			return stringStream.str();
+		}
 		else if(BaseLib::HelperFunctions::checkCliCommand(command, "peers create", "pc", "", 3, arguments, showHelp))
 		{
 			if(showHelp)
 			{
 				stringStream << "Description: This command creates a new peer." << std::endl;
-				stringStream << "Usage: peers create ADDRESS" << std::endl << std::endl;
+				stringStream << "Usage: peers create INTERFACE TYPE ADDRESS" << std::endl << std::endl;
 				stringStream << "Parameters:" << std::endl;
 				stringStream << "  INTERFACE: The id of the interface to associate the new device to as defined in the familie's configuration file." << std::endl;
+				stringStream << "  TYPE:      The device type. 1 for a single remote, 2 for a remote with 16 channels." << std::endl;
 				stringStream << "  ADDRESS:   The 6 digit hex number that uniquely identifies the remote. Example: 0x952B7A" << std::endl;
+				stringStream << "             Multi-channel remotes use one consecutive address per channel starting at ADDRESS." << std::endl;
 				return stringStream.str();
 			}
 
 			std::string interfaceId = arguments.at(0);
 			if(GD::physicalInterfaces.find(interfaceId) == GD::physicalInterfaces.end()) return "Unknown physical interface.\n";
+			uint32_t deviceType = BaseLib::Math::getNumber(arguments.at(1));
 			int32_t address = BaseLib::Math::getNumber(arguments.at(2));
 			std::string serial = "RTS" + BaseLib::HelperFunctions::getHexString(address, 6);
 
 			if(peerExists(serial) || peerExists(address)) stringStream << "A peer with this address is already paired to this central." << std::endl;
 			else
 			{
-				std::shared_ptr<MyPeer> peer = createPeer(0x01, address, serial, false);
+				std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+				std::shared_ptr<MyPeer> peer = createPeer(deviceType, address, serial, false);
 				if(!peer || !peer->getRpcDevice()) return "Device type not supported.\n";
+				if(!addressRangeValid(address, peer->getAddressCount())) return "The address range of the new peer exceeds 0xFFFFFF.\n";
+				if(addressesInUse(address, peer->getAddressCount())) return "A peer with an address in the range of the new peer is already paired to this central.\n";
 				try
 				{
 					_peersMutex.lock();
@@ -416,6 +1098,7 @@ std::string MyCentral::handleCliCommand(std::string command)
 				std::vector<uint64_t> newIds{ peer->getID() };
 				raiseRPCNewDevices(newIds, deviceDescriptions);
 				GD::out.printMessage("Added peer " + std::to_string(peer->getID()) + ".");
+				addOperationTime(PeerOperation::create, 1, startTime);
 				stringStream << "Added peer " << std::to_string(peer->getID()) << " with address 0x" << BaseLib::HelperFunctions::getHexString(address, 6) << " and serial number " << serial << "." << std::dec << std::endl;
 			}
 			return stringStream.str();
@@ -634,7 +1317,7 @@ std::shared_ptr<MyPeer> MyCentral::createPeer(uint32_t deviceType, int32_t addre
 		peer->setRollingCode(0);
 		peer->setEncryptionKey(0xA0);
 		peer->setSerialNumber(serialNumber);
-		peer->setRpcDevice(GD::family->getRpcDevices()->find(deviceType, 0x10, -1));
+		peer->setRpcDevice(GD::family->getRpcDevice(deviceType, 0x10));
 		if(!peer->getRpcDevice()) return std::shared_ptr<MyPeer>();
 		if(save) peer->save(true, true, false); //Save and create peerID
 		return peer;
@@ -653,8 +1336,11 @@ PVariable MyCentral::createDevice(BaseLib::PRpcClientInfo clientInfo, int32_t de
 		std::string serial = "RTS" + BaseLib::HelperFunctions::getHexString(address, 6);
 		if(peerExists(serial)) return Variable::createError(-5, "This peer is already paired to this central.");
 
-		std::shared_ptr<MyPeer> peer = createPeer(0x01, address, serial, false);
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		std::shared_ptr<MyPeer> peer = createPeer(deviceType == 0 ? (int32_t)MyPeer::DeviceType::rtsSwitch : deviceType, address, serial, false);
 		if(!peer || !peer->getRpcDevice()) return Variable::createError(-6, "Unknown device type.");
+		if(!addressRangeValid(address, peer->getAddressCount())) return Variable::createError(-1, "The address range of this peer exceeds 0xFFFFFF.");
+		if(addressesInUse(address, peer->getAddressCount())) return Variable::createError(-5, "An address in the range of this peer is already in use.");
 
 		try
 		{
@@ -678,6 +1364,7 @@ PVariable MyCentral::createDevice(BaseLib::PRpcClientInfo clientInfo, int32_t de
 		std::vector<uint64_t> newIds{ peer->getID() };
 		raiseRPCNewDevices(newIds, deviceDescriptions);
 		GD::out.printMessage("Added peer " + std::to_string(peer->getID()) + ".");
+		addOperationTime(PeerOperation::create, 1, startTime);
 
 		return PVariable(new Variable((uint32_t)peer->getID()));
 	}
@@ -750,4 +1437,80 @@ PVariable MyCentral::setInterface(BaseLib::PRpcClientInfo clientInfo, uint64_t p
     return Variable::createError(-32500, "Unknown application error.");
 }
 
+PVariable MyCentral::getInterfaceHealth(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters)
+{
+	try
+	{
+		if(!parameters->empty() && parameters->at(0)->type != VariableType::tString) return Variable::createError(-1, "Parameter 1 is not of type String.");
+
+		PVariable result = std::make_shared<Variable>(VariableType::tStruct);
+		for(auto& interface : GD::physicalInterfaces)
+		{
+			if(!parameters->empty() && interface.first != parameters->at(0)->stringValue) continue;
+			HealthMonitor::Statistics statistics = interface.second->getHealthStatistics();
+			PVariable health = std::make_shared<Variable>(VariableType::tStruct);
+			health->structValue->emplace("STATE", std::make_shared<Variable>(HealthMonitor::getStateName(statistics.state)));
+			health->structValue->emplace("LATENCY", std::make_shared<Variable>(statistics.latency));
+			health->structValue->emplace("JITTER", std::make_shared<Variable>(statistics.jitter));
+			health->structValue->emplace("PROBES", std::make_shared<Variable>(statistics.probes));
+			health->structValue->emplace("TIMEOUTS", std::make_shared<Variable>(statistics.timeouts));
+			health->structValue->emplace("LAST_RESPONSE", std::make_shared<Variable>(statistics.lastResponse / 1000));
+			ISomfyInterface::FirmwareInfo firmware = interface.second->getFirmwareInfo();
+			health->structValue->emplace("FIRMWARE", std::make_shared<Variable>(firmware.version));
+			health->structValue->emplace("BOARD", std::make_shared<Variable>(firmware.board));
+			health->structValue->emplace("RTS_SUPPORTED", std::make_shared<Variable>(firmware.rts));
+			health->structValue->emplace("STARTUP_TIME", std::make_shared<Variable>(interface.second->getStartupTime()));
+			result->structValue->emplace(interface.first, health);
+		}
+		if(!parameters->empty() && result->structValue->empty()) return Variable::createError(-2, "Unknown physical interface.");
+		return result;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
+PVariable MyCentral::exportPeers(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters)
+{
+	try
+	{
+		std::ostringstream output;
+		writePeerExport(output);
+		return std::make_shared<Variable>(output.str());
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
+PVariable MyCentral::importPeers(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters)
+{
+	try
+	{
+		if(parameters->size() != 1) return Variable::createError(-1, "Wrong parameter count.");
+		if(parameters->at(0)->type != VariableType::tString) return Variable::createError(-1, "Parameter 1 is not of type String.");
+
+		std::istringstream input(parameters->at(0)->stringValue);
+		ImportResult importResult;
+		std::string error;
+		if(!readPeerImport(input, importResult, error)) return Variable::createError(-5, error);
+
+		PVariable result = std::make_shared<Variable>(VariableType::tStruct);
+		result->structValue->emplace("CREATED", std::make_shared<Variable>(importResult.created));
+		result->structValue->emplace("UPDATED", std::make_shared<Variable>(importResult.updated));
+		result->structValue->emplace("DEFAULT_INTERFACE", std::make_shared<Variable>(importResult.defaultInterface));
+		result->structValue->emplace("DURATION", std::make_shared<Variable>(importResult.duration));
+		return result;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
 }
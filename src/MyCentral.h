@@ -33,8 +33,11 @@
 
 #include "MyPeer.h"
 #include "MyPacket.h"
+#include "DuplicateFilter.h"
+#include "RemoteAddressIndex.h"
 #include <homegear-base/BaseLib.h>
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -50,6 +53,7 @@ public:
 	MyCentral(uint32_t deviceType, std::string serialNumber, ICentralEventSink* eventHandler);
 	virtual ~MyCentral();
 	virtual void dispose(bool wait = true);
+	virtual void homegearShuttingDown();
 
 	std::string handleCliCommand(std::string command);
 	virtual bool onPacketReceived(std::string& senderId, std::shared_ptr<BaseLib::Systems::Packet> packet);
@@ -60,12 +64,55 @@ public:
 
 	bool processPacket(const std::string& senderId, std::shared_ptr<MyPacket> myPacket);
 
+	/**
+	 * Associates the addresses of physical remotes with the peer, so their frames feed its interface selection.
+	 */
+	void setRemoteAddresses(uint64_t peerId, const std::vector<int32_t>& addresses);
+
 	virtual PVariable createDevice(BaseLib::PRpcClientInfo clientInfo, int32_t deviceType, std::string serialNumber, int32_t address, int32_t firmwareVersion, std::string interfaceId);
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, std::string serialNumber, int32_t flags);
 	virtual PVariable deleteDevice(BaseLib::PRpcClientInfo clientInfo, uint64_t peerId, int32_t flags);
 	virtual PVariable setInterface(BaseLib::PRpcClientInfo clientInfo, uint64_t peerId, std::string interfaceId);
+	PVariable getInterfaceHealth(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters);
+	PVariable exportPeers(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters);
+	PVariable importPeers(BaseLib::PRpcClientInfo clientInfo, BaseLib::PArray parameters);
 
 protected:
+	std::mutex _replayThreadMutex;
+	std::thread _replayThread;
+	std::mutex _replayStopMutex;
+	std::condition_variable _replayStopConditionVariable;
+	bool _stopReplay = false;
+	DuplicateFilter _duplicateFilter; //Of received frames
+	RemoteAddressIndex _remoteAddressIndex; //Of REMOTE_ADDRESSES
+
+	// {{{ Timing of database heavy peer operations
+	enum class PeerOperation : int32_t
+	{
+		load = 0,
+		save = 1,
+		create = 2,
+		remove = 3
+	};
+	static constexpr size_t peerOperationCount = 4;
+
+	struct OperationStatistics
+	{
+		uint64_t calls = 0;
+		uint64_t peers = 0; //Peers loaded, saved, created or deleted
+		int64_t durationSum = 0; //Microseconds
+		int64_t maxDuration = 0; //Microseconds
+	};
+
+	std::mutex _operationStatisticsMutex;
+	OperationStatistics _operationStatistics[peerOperationCount];
+
+	/**
+	 * Adds the time since startTime to the statistics shown by "peers timings".
+	 */
+	void addOperationTime(PeerOperation operation, size_t peers, std::chrono::steady_clock::time_point startTime);
+	// }}}
+
 	virtual void init();
 	virtual void loadPeers();
 	virtual void savePeers(bool full);
@@ -73,6 +120,43 @@ protected:
 	virtual void saveVariables() {}
 	std::shared_ptr<MyPeer> createPeer(uint32_t deviceType, int32_t address, std::string serialNumber, bool save = true);
 	void deletePeer(uint64_t id);
+	bool addressesInUse(int32_t address, uint32_t count);
+	static bool addressRangeValid(int32_t address, uint32_t count);
+	void replayTraffic(std::string interfaceId, std::string filename);
+
+	/**
+	 * Interrupts a replay running in the background and waits for it to end. Must be called with _replayThreadMutex locked.
+	 */
+	void stopReplay();
+
+	// {{{ Export and import of peers
+	struct ImportResult
+	{
+		uint32_t created = 0;
+		uint32_t updated = 0;
+		uint32_t defaultInterface = 0; //Peers with an interface unknown to this installation, which now use the default one
+		int64_t duration = 0; //Milliseconds
+	};
+
+	/**
+	 * Writes one line per peer: ADDRESS TYPE ROLLING_CODE KEY INTERFACE CHANNEL_CODES NAME. Address, codes and keys are
+	 * hexadecimal, CHANNEL_CODES lists "CODE:KEY" per channel of a multi-channel remote separated by commas ("-" for
+	 * single remotes) and NAME is the rest of the line. Lines starting with "#" are comments.
+	 *
+	 * @return Returns the number of peers written.
+	 */
+	size_t writePeerExport(std::ostream& output);
+
+	/**
+	 * Reads the format written by writePeerExport(). Peers with an address not paired yet are created, existing peers of
+	 * the same type get the rolling codes, interface and name of the input. The whole input is checked before the
+	 * first peer is changed, so either all lines are applied or none.
+	 *
+	 * @param[out] error The reasons the input was rejected.
+	 * @return Returns false if the input was rejected.
+	 */
+	bool readPeerImport(std::istream& input, ImportResult& result, std::string& error);
+	// }}}
 
 	std::pair<int32_t, int32_t> getOldItGroupStartCodeAndChannel(int32_t address);
 };
@@ -43,7 +43,25 @@ MyFamily::MyFamily(BaseLib::SharedObjects* bl, BaseLib::Systems::IFamilyEventSin
 	GD::out.init(bl);
 	GD::out.setPrefix(std::string("Module ") + MY_FAMILY_NAME + ": ");
 	GD::out.printDebug("Debug: Loading module...");
+	GD::supersedeProg = _settings->getNumber("supersedeprog") != 0;
+	GD::frameAirtime = _settings->getNumber("frameairtime");
+	if(_settings->get("dutycyclereserve")) GD::dutyCycleReserve = _settings->getNumber("dutycyclereserve");
+	GD::maxQueuedPackets = _settings->getNumber("maxqueuedpackets");
+	if(_settings->get("maxqueuedelay")) GD::maxQueueDelay = _settings->getNumber("maxqueuedelay");
+	GD::rejectWhileDisconnected = _settings->getNumber("rejectwhiledisconnected") != 0;
+	if(_settings->get("probeinterval")) GD::probeInterval = _settings->getNumber("probeinterval");
+	if(_settings->get("probetimeout")) GD::probeTimeout = _settings->getNumber("probetimeout");
+	if(_settings->get("degradedlatency")) GD::degradedLatency = _settings->getNumber("degradedlatency");
+	if(_settings->get("shutdowntimeout")) GD::shutdownTimeout = _settings->getNumber("shutdowntimeout");
+	GD::autoSelectInterface = _settings->getNumber("autoselectinterface") != 0;
+	if(_settings->get("interfaceselectionmargin")) GD::interfaceSelectionMargin = _settings->getNumber("interfaceselectionmargin");
+	if(_settings->get("duplicatewindow")) GD::duplicateWindow = std::min(std::max(_settings->getNumber("duplicatewindow"), 0), 60000);
 	_physicalInterfaces.reset(new Interfaces(bl, _settings->getPhysicalInterfaceSettings()));
+
+	int32_t commandThreads = _settings->getNumber("commandthreads");
+	if(commandThreads <= 0) commandThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), 4u);
+	GD::commandExecutor = std::make_shared<StrandExecutor>();
+	GD::commandExecutor->start(commandThreads);
 }
 
 MyFamily::~MyFamily()
@@ -54,6 +72,7 @@ MyFamily::~MyFamily()
 void MyFamily::dispose()
 {
 	if(_disposed) return;
+	if(GD::commandExecutor) GD::commandExecutor->stop();
 	DeviceFamily::dispose();
 
 	_central.reset();
@@ -82,6 +101,42 @@ PVariable MyFamily::getPairingInfo()
 	try
 	{
 		if(!_central) return std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+		std::lock_guard<std::mutex> pairingInfoGuard(_pairingInfoMutex);
+		if(_pairingInfo) return _pairingInfo;
+		PVariable info = createPairingInfo();
+		if(!info->errorStruct) _pairingInfo = info;
+		return info;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return Variable::createError(-32500, "Unknown application error.");
+}
+
+BaseLib::DeviceDescription::PHomegearDevice MyFamily::getRpcDevice(uint32_t deviceType, uint32_t firmwareVersion)
+{
+	try
+	{
+		std::lock_guard<std::mutex> rpcDevicesCacheGuard(_rpcDevicesCacheMutex);
+		auto deviceIterator = _rpcDevicesCache.find(std::make_pair(deviceType, firmwareVersion));
+		if(deviceIterator != _rpcDevicesCache.end()) return deviceIterator->second;
+		BaseLib::DeviceDescription::PHomegearDevice rpcDevice = _rpcDevices->find(deviceType, firmwareVersion, -1);
+		//Unknown types aren't remembered, so invalid input can't grow the cache.
+		if(rpcDevice) _rpcDevicesCache.emplace(std::make_pair(deviceType, firmwareVersion), rpcDevice);
+		return rpcDevice;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return BaseLib::DeviceDescription::PHomegearDevice();
+}
+
+PVariable MyFamily::createPairingInfo()
+{
+	try
+	{
 		PVariable info = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
 
 		//{{{ General
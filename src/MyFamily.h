@@ -47,8 +47,23 @@ public:
 	virtual void dispose();
 
 	virtual bool hasPhysicalInterface() { return true; }
+
+	/**
+	 * The pairing info only depends on the module, so it is built once. Callers must not modify it.
+	 */
 	virtual PVariable getPairingInfo();
+
+	/**
+	 * Same as getRpcDevices()->find(), but remembers the result. Used for every peer created or loaded.
+	 */
+	BaseLib::DeviceDescription::PHomegearDevice getRpcDevice(uint32_t deviceType, uint32_t firmwareVersion);
 protected:
+	std::mutex _pairingInfoMutex;
+	PVariable _pairingInfo;
+	std::mutex _rpcDevicesCacheMutex;
+	std::map<std::pair<uint32_t, uint32_t>, BaseLib::DeviceDescription::PHomegearDevice> _rpcDevicesCache;
+
+	PVariable createPairingInfo();
 	virtual std::shared_ptr<BaseLib::Systems::ICentral> initializeCentral(uint32_t deviceId, int32_t address, std::string serialNumber);
 	virtual void createCentral();
 };
@@ -35,20 +35,68 @@
 
 namespace MyFamily
 {
-MyPacket::MyPacket()
+MyPacket::MyPacket() : _result(_resultPromise.get_future().share())
 {
 }
 
-MyPacket::MyPacket(std::string& payload) : _payload(payload)
+MyPacket::MyPacket(std::string& payload) : _payload(payload), _result(_resultPromise.get_future().share())
 {
 
 }
 
 MyPacket::~MyPacket()
 {
+	//Packets released without being handled (e. g. by an interface type that doesn't queue) count as dropped.
+	setResult(TransmitResult::dropped);
 	_payload.clear();
 }
 
+std::shared_ptr<MyPacket> MyPacket::fromReceivedFrame(const std::string& frame)
+{
+	if(frame.size() < 16 || frame.compare(0, 2, "Ys") != 0) return std::shared_ptr<MyPacket>();
+	size_t length = frame.size() >= 18 ? 18 : 16;
+	for(size_t i = 2; i < length; i++)
+	{
+		if(!std::isxdigit(frame[i])) return std::shared_ptr<MyPacket>();
+	}
+	std::vector<uint8_t> data = BaseLib::HelperFunctions::getUBinary(frame.substr(2, length - 2));
+	if(data.size() < 7) return std::shared_ptr<MyPacket>();
+
+	//Every byte is XORed with the one before it.
+	for(int32_t i = 6; i > 0; i--)
+	{
+		data[i] ^= data[i - 1];
+	}
+	uint8_t checksum = 0;
+	for(int32_t i = 0; i < 7; i++)
+	{
+		checksum ^= data[i] ^ (data[i] >> 4);
+	}
+	if((checksum & 0x0F) != 0) return std::shared_ptr<MyPacket>();
+
+	std::shared_ptr<MyPacket> packet = std::make_shared<MyPacket>();
+	//Same layout as the payload of packets to send: The address is stored most significant byte first.
+	packet->_payload = BaseLib::HelperFunctions::getHexString(std::vector<uint8_t>{ data[0], data[1], data[2], data[3], data[6], data[5], data[4] });
+	packet->_controlCode = data[1] >> 4;
+	packet->_rollingCode = ((uint16_t)data[2] << 8) | data[3];
+	//The address is sent least significant byte first.
+	packet->_senderAddress = ((int32_t)data[6] << 16) | ((int32_t)data[5] << 8) | data[4];
+	packet->_timeReceived = BaseLib::HelperFunctions::getTime();
+	if(data.size() > 7)
+	{
+		//culfw reports the RSSI as in the CC1101 datasheet.
+		int32_t rssi = data[7];
+		packet->_rssi = (rssi >= 128 ? (rssi - 256) / 2 : rssi / 2) - 74;
+	}
+	return packet;
+}
+
+void MyPacket::setResult(TransmitResult result)
+{
+    if(_resultSet.test_and_set()) return;
+    _resultPromise.set_value(result);
+}
+
 std::string& MyPacket::hexString()
 {
     return _payload;
@@ -33,9 +33,33 @@
 
 #include <homegear-base/BaseLib.h>
 
+#include <future>
+
 namespace MyFamily
 {
 
+/**
+ * What happened to a packet handed to an interface.
+ */
+enum class TransmitResult : int32_t
+{
+	sent = 0, //Written to the device
+	superseded = 1, //Replaced by a newer packet for the same remote before it was sent
+	dropped = 2 //Not sent, because the device was unavailable for too long, the queue was full or the interface stopped
+};
+
+/**
+ * High priority packets (e. g. wind and rain protection) are sent before normal ones and may use the share of the duty
+ * cycle budget reserved for them.
+ */
+enum class TransmitPriority : int32_t
+{
+	normal = 0,
+	high = 1
+};
+
+constexpr size_t transmitPriorityCount = 2;
+
 class MyPacket : public BaseLib::Systems::Packet
 {
     public:
@@ -43,16 +67,70 @@ class MyPacket : public BaseLib::Systems::Packet
         MyPacket(std::string& payload);
         virtual ~MyPacket();
 
+        /**
+         * Decodes a frame received by culfw ("Ys" followed by the 7 obfuscated frame bytes and, with "X21", the RSSI
+         * byte).
+         *
+         * @return Returns nullptr if the line is not a valid RTS frame.
+         */
+        static std::shared_ptr<MyPacket> fromReceivedFrame(const std::string& frame);
+
         int32_t getChannel() { return _channel; }
         void setChannel(int32_t value) { _channel = value; }
         std::string getPayload() { return _payload; }
         std::string& hexString();
         std::string& culHexString();
 
+        void setSenderAddress(int32_t value) { _senderAddress = value; }
+
+        /**
+         * The rolling code of a received frame or of a frame sent by the module. The transmit queue uses it to keep the
+         * newer of two frames of the same remote.
+         */
+        uint16_t getRollingCode() { return _rollingCode; }
+        void setRollingCode(uint16_t value) { _rollingCode = value; }
+
+        //{{{ Only set for received frames
+        uint8_t getControlCode() { return _controlCode; }
+
+        /**
+         * The signal strength in dBm. 0 if unknown.
+         */
+        int32_t getRssi() { return _rssi; }
+        //}}}
+
+        /**
+         * While queued, a packet is replaced by a newer packet with the same sender address and group. -1 (the default)
+         * means the packet is never replaced.
+         */
+        int32_t getSupersedeGroup() { return _supersedeGroup; }
+        void setSupersedeGroup(int32_t value) { _supersedeGroup = value; }
+
+        TransmitPriority getPriority() { return _priority; }
+        void setPriority(TransmitPriority value) { _priority = value; }
+
+        /**
+         * Becomes ready once the interface sent, replaced or dropped the packet.
+         */
+        std::shared_future<TransmitResult> getResult() { return _result; }
+
+        /**
+         * Called by the interfaces. Only the first call has an effect.
+         */
+        void setResult(TransmitResult result);
+
     protected:
         std::string _payload;
         std::string _culpacket;
         int32_t _channel = -1;
+        int32_t _supersedeGroup = -1;
+        TransmitPriority _priority = TransmitPriority::normal;
+        uint8_t _controlCode = 0;
+        uint16_t _rollingCode = 0;
+        int32_t _rssi = 0;
+        std::atomic_flag _resultSet = ATOMIC_FLAG_INIT;
+        std::promise<TransmitResult> _resultPromise;
+        std::shared_future<TransmitResult> _result;
 };
 
 typedef std::shared_ptr<MyPacket> PMyPacket;
@@ -33,7 +33,10 @@
 #include "GD.h"
 #include "MyPacket.h"
 #include "MyCentral.h"
+#include "Logging.h"
+#include "RemoteAddressIndex.h"
 
+#include <cmath>
 #include <iomanip>
 
 namespace MyFamily
@@ -79,6 +82,7 @@ void MyPeer::init()
 {
 	try
 	{
+		_strand = std::make_shared<StrandExecutor::Strand>();
 	}
 	catch(const std::exception& ex)
 	{
@@ -109,6 +113,9 @@ void MyPeer::homegearShuttingDown()
 	try
 	{
 		_shuttingDown = true;
+		//No more commands are processed (see MyCentral::homegearShuttingDown()), so this is the final value.
+		saveRollingCode();
+		if(!_remoteChannels.empty()) saveRemoteChannels();
 		Peer::homegearShuttingDown();
 	}
 	catch(const std::exception& ex)
@@ -129,6 +136,41 @@ std::string MyPeer::handleCliCommand(std::string command)
 			stringStream << "For more information about the individual command type: COMMAND help" << std::endl << std::endl;
 			stringStream << "unselect\t\tUnselect this peer" << std::endl;
 			stringStream << "config print\t\tPrints all configuration parameters and their values" << std::endl;
+			stringStream << "rssi\t\t\tShows how well the interfaces receive this peer" << std::endl;
+			return stringStream.str();
+		}
+		else if(command.compare(0, 4, "rssi") == 0)
+		{
+			if(command.size() > 5 && command.compare(5, 4, "help") == 0)
+			{
+				stringStream << "Description: This command lists the signal strength of the frames with this peer's addresses per interface. Frames are sent by remotes paired with the same motor or by other interfaces." << std::endl;
+				stringStream << "Usage: rssi" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  There are no parameters." << std::endl;
+				return stringStream.str();
+			}
+			std::map<std::string, RssiStatistics> rssiStatistics = getRssiStatistics();
+			if(rssiStatistics.empty()) return "No frames received yet.\n";
+			std::string currentId = getPhysicalInterfaceId();
+			std::string bar(" │ ");
+			stringStream << std::setfill(' ')
+				<< std::setw(24) << "Interface" << bar
+				<< std::setw(8) << "RSSI" << bar
+				<< std::setw(8) << "Last" << bar
+				<< std::setw(8) << "Frames" << bar
+				<< "Last frame"
+				<< std::endl;
+			for(auto& statistics : rssiStatistics)
+			{
+				stringStream
+					<< std::setw(24) << (statistics.first == currentId ? "* " : "") + statistics.first << bar
+					<< std::setw(8) << std::lround(statistics.second.rssi) << bar
+					<< std::setw(8) << statistics.second.lastRssi << bar
+					<< std::setw(8) << statistics.second.frames << bar
+					<< BaseLib::HelperFunctions::getTimeString(statistics.second.lastFrame)
+					<< std::endl;
+			}
+			stringStream << std::endl << "RSSI values are in dBm. * marks the interface used for sending." << std::endl;
 			return stringStream.str();
 		}
 		else if(command.compare(0, 12, "config print") == 0)
@@ -215,6 +257,17 @@ std::string MyPeer::printConfig()
 		}
 		stringStream << "}" << std::endl << std::endl;
 
+		if(!_remoteChannels.empty())
+		{
+			stringStream << "CHANNELS" << std::endl;
+			stringStream << "{" << std::endl;
+			for(uint32_t i = 0; i < _remoteChannels.size(); i++)
+			{
+				stringStream << "\t" << "Channel " << std::dec << (i + 1) << ": Address 0x" << BaseLib::HelperFunctions::getHexString(_remoteChannels[i].address, 6) << ", rolling code " << _remoteChannels[i].rollingCode.get().rollingCode << ", key 0x" << BaseLib::HelperFunctions::getHexString(_remoteChannels[i].rollingCode.get().encryptionKey, 2) << std::endl;
+			}
+			stringStream << "}" << std::endl << std::endl;
+		}
+
 		return stringStream.str();
 	}
 	catch(const std::exception& ex)
@@ -243,43 +296,344 @@ void MyPeer::setPhysicalInterfaceId(std::string id)
 		setPhysicalInterface(GD::defaultPhysicalInterface);
 		saveVariable(19, _physicalInterfaceId);
 	}
+	markChanged();
 }
 
-void MyPeer::setRollingCode(uint32_t code)
+void MyPeer::setName(std::string name)
+{
+	Peer::setName(name);
+	markChanged();
+}
+
+void MyPeer::setName(int32_t channel, std::string name)
+{
+	Peer::setName(channel, name);
+	markChanged();
+}
+
+bool MyPeer::saveChanges()
 {
 	try
 	{
-		_rollingCode = code;
-		saveVariable(17, (int32_t)code);
-		if(valuesCentral.find(0) != valuesCentral.end() && valuesCentral.at(0).find("ROLLING_CODE") != valuesCentral.at(0).end())
+		uint64_t generation = _changeGeneration;
+		if(generation == _savedGeneration) return false;
+		save(true, true, true);
+		_savedGeneration = generation;
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void MyPeer::rssiReceived(const std::string& interfaceId, PMyPacket packet)
+{
+	_interfaceSelector.rssiReceived(interfaceId, packet->getRssi(), packet->timeReceived());
+}
+
+void MyPeer::frameReceived(const std::string& interfaceId, PMyPacket packet)
+{
+	try
+	{
+		if(packet->getRssi() == 0) return; //RSSI reporting ("X21") is off
+
+		//The copy received by the peer's own interface might not be the one processed.
+		int32_t rssi = _interfaceSelector.getLastRssi(getPhysicalInterfaceId());
+		if(rssi != 0 && rssi != _lastRssiDevice)
 		{
-			BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[0]["ROLLING_CODE"];
-			std::vector<uint8_t> parameterData{ (uint8_t)_rollingCode };
-			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, 0, "ROLLING_CODE", parameterData);
+			_lastRssiDevice = rssi;
+			ParameterHandle* handle = getParameterHandle(0, ParameterId::rssiDevice);
+			if(handle)
+			{
+				saveParameterHandle(*handle, 0, rssi);
+				std::shared_ptr<std::vector<std::string>> valueKeys = std::make_shared<std::vector<std::string>>(1, "RSSI_DEVICE");
+				std::shared_ptr<std::vector<PVariable>> values = std::make_shared<std::vector<PVariable>>(1, std::make_shared<Variable>(rssi));
+				std::string eventSource = "device-" + std::to_string(_peerID);
+				std::string address = _serialNumber + ":0";
+				raiseEvent(eventSource, _peerID, 0, valueKeys, values);
+				raiseRPCEvent(eventSource, _peerID, 0, address, valueKeys, values);
+			}
 		}
+
+		if(GD::autoSelectInterface) selectInterface();
 	}
 	catch(const std::exception& ex)
-    {
-    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    }
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
 }
 
-void MyPeer::setEncryptionKey(uint32_t key)
+std::map<std::string, MyPeer::RssiStatistics> MyPeer::getRssiStatistics()
+{
+	return _interfaceSelector.getStatistics();
+}
+
+std::vector<int32_t> MyPeer::getRemoteAddresses()
+{
+	std::lock_guard<std::mutex> remoteAddressesGuard(_remoteAddressesMutex);
+	return _remoteAddresses;
+}
+
+bool MyPeer::isOwnFrame(int32_t address, uint16_t rollingCode)
+{
+	//Commands can still be in the transmit queues while newer ones reserve codes, so a few codes are checked, not only the last.
+	static const uint16_t ownCodeWindow = 16;
+	RollingCode::Value next = _rollingCode.get();
+	for(auto& remoteChannel : _remoteChannels)
+	{
+		if((int32_t)remoteChannel.address != address) continue;
+		next = remoteChannel.rollingCode.get();
+		break;
+	}
+	//Codes are handed out in ascending order, so the ones sent lately are just below the next one.
+	return (uint16_t)(next.rollingCode - rollingCode - 1) < ownCodeWindow;
+}
+
+void MyPeer::selectInterface()
 {
 	try
 	{
-		_encryptionKey = key;
-		saveVariable(16, (int32_t)key);
-		if(valuesCentral.find(0) != valuesCentral.end() && valuesCentral.at(0).find("ENCRYPTION_KEY") != valuesCentral.at(0).end())
+		if(GD::physicalInterfaces.size() < 2) return;
+		std::string currentId = getPhysicalInterfaceId();
+		auto currentInterface = GD::physicalInterfaces.find(currentId);
+		bool currentUsable = currentInterface != GD::physicalInterfaces.end() && currentInterface->second && currentInterface->second->getHealthState() != HealthMonitor::State::failed;
+		InterfaceSelector::Selection selection = _interfaceSelector.select(currentId, currentUsable, [](const std::string& interfaceId)
 		{
-			BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[0]["ENCRYPTION_KEY"];
-			std::vector<uint8_t> parameterData{ (uint8_t)_encryptionKey };
-			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, 0, "ENCRYPTION_KEY", parameterData);
+			auto interfaceIterator = GD::physicalInterfaces.find(interfaceId);
+			return interfaceIterator != GD::physicalInterfaces.end() && interfaceIterator->second && interfaceIterator->second->getHealthState() != HealthMonitor::State::failed;
+		}, BaseLib::HelperFunctions::getTime(), GD::interfaceSelectionMargin);
+		if(selection.interfaceId.empty()) return;
+
+		GD::out.printInfo("Info: Peer " + std::to_string(_peerID) + " now sends using interface " + selection.interfaceId + " (" + std::to_string(std::lround(selection.rssi)) + " dBm) instead of " + currentId + (selection.currentKnown ? " (" + std::to_string(std::lround(selection.currentRssi)) + " dBm)." : "."));
+		setPhysicalInterfaceId(selection.interfaceId);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+int32_t MyPeer::getParameterIndex(const std::string& valueKey)
+{
+	static const std::unordered_map<std::string, int32_t> parameterIndexes = []()
+	{
+		std::unordered_map<std::string, int32_t> indexes
+		{
+			{ "PEER_ID", (int32_t)ParameterId::peerId },
+			{ "ROLLING_CODE", (int32_t)ParameterId::rollingCode },
+			{ "ENCRYPTION_KEY", (int32_t)ParameterId::encryptionKey },
+			{ "RSSI_DEVICE", (int32_t)ParameterId::rssiDevice }
+		};
+		for(size_t i = 0; i < rtsCommandCount; i++)
+		{
+			indexes.emplace(rtsCommands[i].id, (int32_t)ParameterId::command + i);
+		}
+		return indexes;
+	}();
+	auto parameterIndexIterator = parameterIndexes.find(valueKey);
+	if(parameterIndexIterator == parameterIndexes.end()) return (int32_t)ParameterId::none;
+	return parameterIndexIterator->second;
+}
+
+void MyPeer::initializeCentralConfig()
+{
+	Peer::initializeCentralConfig();
+	initializeParameterHandles();
+	if(_deviceType == DeviceType::rtsMultiRemote && _remoteChannels.empty()) initializeRemoteChannels();
+}
+
+uint32_t MyPeer::getAddressCount()
+{
+	if(!_remoteChannels.empty()) return _remoteChannels.size();
+	if(_deviceType == DeviceType::rtsMultiRemote) return getRemoteChannelCount();
+	return 1;
+}
+
+uint32_t MyPeer::getRemoteChannelCount()
+{
+	uint32_t channelCount = 0;
+	if(!_rpcDevice) return channelCount;
+	for(auto& function : _rpcDevice->functions)
+	{
+		if(function.first > channelCount) channelCount = function.first;
+	}
+	return channelCount;
+}
+
+void MyPeer::initializeRemoteChannels()
+{
+	try
+	{
+		uint32_t channelCount = getRemoteChannelCount();
+		if(channelCount == 0) return;
+		//The channels use consecutive addresses starting at the peer's address.
+		_remoteChannels.clear();
+		_remoteChannels.resize(channelCount);
+		for(uint32_t i = 0; i < channelCount; i++)
+		{
+			_remoteChannels[i].address = (_address + i) & 0xFFFFFF;
+		}
+		saveRemoteChannels();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void MyPeer::loadRemoteChannels(const std::vector<char>& data)
+{
+	_remoteChannels.clear();
+	_remoteChannels.resize(data.size() / 6);
+	for(uint32_t i = 0; i < _remoteChannels.size(); i++)
+	{
+		const uint8_t* channelData = (const uint8_t*)data.data() + (i * 6);
+		_remoteChannels[i].address = ((uint32_t)channelData[0] << 16) | ((uint32_t)channelData[1] << 8) | channelData[2];
+		_remoteChannels[i].rollingCode.setRollingCode(((uint16_t)channelData[3] << 8) | channelData[4]);
+		_remoteChannels[i].rollingCode.setEncryptionKey(channelData[5]);
+	}
+}
+
+void MyPeer::saveRemoteChannels()
+{
+	try
+	{
+		std::lock_guard<std::mutex> rollingCodeSaveGuard(_rollingCodeSaveMutex);
+		std::vector<char> data;
+		data.reserve(_remoteChannels.size() * 6);
+		for(auto& remoteChannel : _remoteChannels)
+		{
+			RollingCode::Value code = remoteChannel.rollingCode.get();
+			data.push_back((char)(remoteChannel.address >> 16));
+			data.push_back((char)(remoteChannel.address >> 8));
+			data.push_back((char)remoteChannel.address);
+			data.push_back((char)(code.rollingCode >> 8));
+			data.push_back((char)code.rollingCode);
+			data.push_back((char)code.encryptionKey);
+		}
+		saveVariable(20, data);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void MyPeer::initializeParameterHandles()
+{
+	try
+	{
+		_parameterHandles.clear();
+		for(auto& channelIterator : valuesCentral)
+		{
+			for(auto& parameterIterator : channelIterator.second)
+			{
+				int32_t parameterIndex = getParameterIndex(parameterIterator.first);
+				if(parameterIndex == (int32_t)ParameterId::none || !parameterIterator.second.rpcParameter) continue;
+				if(channelIterator.first >= _parameterHandles.size()) _parameterHandles.resize(channelIterator.first + 1);
+				ParameterHandle& handle = _parameterHandles[channelIterator.first][parameterIndex];
+				handle.parameter = &parameterIterator.second;
+				if(parameterIndex >= (int32_t)ParameterId::command)
+				{
+					const RtsCommand& command = rtsCommands[parameterIndex - (int32_t)ParameterId::command];
+					handle.controlCode = command.controlCode;
+					handle.commandClass = command.commandClass;
+				}
+			}
 		}
+		encodePeerId();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+MyPeer::ParameterHandle* MyPeer::getParameterHandle(uint32_t channel, int32_t parameterIndex)
+{
+	if(parameterIndex < 0 || parameterIndex >= (int32_t)parameterHandleCount || channel >= _parameterHandles.size()) return nullptr;
+	ParameterHandle& handle = _parameterHandles[channel][parameterIndex];
+	return handle.parameter ? &handle : nullptr;
+}
+
+void MyPeer::encodePeerId()
+{
+	//PEER_ID only changes when a new peer is saved for the first time, so it doesn't need to be converted on every getParamset.
+	_encodedPeerId = _peerID;
+	ParameterHandle* handle = getParameterHandle(1, ParameterId::peerId);
+	if(!handle) return;
+	std::vector<uint8_t> parameterData;
+	handle->parameter->rpcParameter->convertToPacket(std::make_shared<Variable>((int32_t)_peerID), handle->parameter->mainRole(), parameterData);
+	handle->parameter->setBinaryData(parameterData);
+}
+
+void MyPeer::saveParameterHandle(ParameterHandle& handle, uint32_t channel, int32_t value)
+{
+	std::vector<uint8_t> parameterData;
+	handle.parameter->rpcParameter->convertToPacket(std::make_shared<Variable>(value), handle.parameter->mainRole(), parameterData);
+	handle.parameter->setBinaryData(parameterData);
+	if(handle.parameter->databaseId > 0) saveParameter(handle.parameter->databaseId, parameterData);
+	else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, handle.parameter->rpcParameter->id, parameterData);
+}
+
+void MyPeer::setRollingCode(uint32_t code)
+{
+	_rollingCode.setRollingCode(code);
+	saveRollingCode();
+	markChanged();
+}
+
+void MyPeer::setEncryptionKey(uint32_t key)
+{
+	_rollingCode.setEncryptionKey(key);
+	saveRollingCode();
+	markChanged();
+}
+
+void MyPeer::setRollingCode(uint32_t code, uint32_t key)
+{
+	_rollingCode.setRollingCode(code);
+	_rollingCode.setEncryptionKey(key);
+	saveRollingCode();
+	markChanged();
+}
+
+std::vector<RollingCode::Value> MyPeer::getRemoteChannelCodes()
+{
+	std::vector<RollingCode::Value> codes;
+	codes.reserve(_remoteChannels.size());
+	for(auto& remoteChannel : _remoteChannels)
+	{
+		codes.push_back(remoteChannel.rollingCode.get());
+	}
+	return codes;
+}
+
+void MyPeer::setRemoteChannelCodes(const std::vector<RollingCode::Value>& codes)
+{
+	for(size_t i = 0; i < codes.size() && i < _remoteChannels.size(); i++)
+	{
+		_remoteChannels[i].rollingCode.setRollingCode(codes[i].rollingCode);
+		_remoteChannels[i].rollingCode.setEncryptionKey(codes[i].encryptionKey);
+	}
+	saveRemoteChannels();
+	markChanged();
+}
+
+void MyPeer::saveRollingCode()
+{
+	try
+	{
+		std::lock_guard<std::mutex> rollingCodeSaveGuard(_rollingCodeSaveMutex);
+		RollingCode::Value code = _rollingCode.get();
+		saveVariable(16, (int32_t)code.encryptionKey);
+		saveVariable(17, (int32_t)code.rollingCode);
+		ParameterHandle* handle = getParameterHandle(0, ParameterId::rollingCode);
+		if(handle) saveParameterHandle(*handle, 0, (int32_t)code.rollingCode);
+		handle = getParameterHandle(0, ParameterId::encryptionKey);
+		if(handle) saveParameterHandle(*handle, 0, (int32_t)code.encryptionKey);
 	}
 	catch(const std::exception& ex)
     {
@@ -307,7 +661,7 @@ void MyPeer::loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<
 		if(!rows) rows = _bl->db->getPeerVariables(_peerID);
 		Peer::loadVariables(central, rows);
 
-		_rpcDevice = GD::family->getRpcDevices()->find(_deviceType, _firmwareVersion, -1);
+		_rpcDevice = GD::family->getRpcDevice(_deviceType, _firmwareVersion);
 		if(!_rpcDevice) return;
 
 		for(BaseLib::Database::DataTable::iterator row = rows->begin(); row != rows->end(); ++row)
@@ -315,15 +669,18 @@ void MyPeer::loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<
 			switch(row->second.at(2)->intValue)
 			{
 			case 16: // Encryption Key
-			    _encryptionKey = (uint32_t)row->second.at(3)->intValue;
+			    _rollingCode.setEncryptionKey((uint8_t)row->second.at(3)->intValue);
 			    break;
 			case 17: // Rolling Code
-			    _rollingCode = (uint32_t)row->second.at(3)->intValue;
+			    _rollingCode.setRollingCode((uint16_t)row->second.at(3)->intValue);
 			    break;
 			case 19:
 				_physicalInterfaceId = row->second.at(4)->textValue;
 				if(!_physicalInterfaceId.empty() && GD::physicalInterfaces.find(_physicalInterfaceId) != GD::physicalInterfaces.end()) setPhysicalInterface(GD::physicalInterfaces.at(_physicalInterfaceId));
 				break;
+			case 20: // Channels of multi-channel remotes
+				if(row->second.at(5)->binaryValue) loadRemoteChannels(*row->second.at(5)->binaryValue);
+				break;
 			}
 		}
 		if(!_physicalInterface) _physicalInterface = GD::defaultPhysicalInterface;
@@ -340,9 +697,10 @@ void MyPeer::saveVariables()
 	{
 		if(_peerID == 0) return;
 		Peer::saveVariables();
-		saveVariable(16, (int32_t)_encryptionKey);
-		saveVariable(17, (int32_t)_rollingCode);
+		saveVariable(16, (int32_t)getEncryptionKey());
+		saveVariable(17, (int32_t)getRollingCode());
 		saveVariable(19, _physicalInterfaceId);
+		if(!_remoteChannels.empty()) saveRemoteChannels();
 	}
 	catch(const std::exception& ex)
     {
@@ -380,6 +738,8 @@ bool MyPeer::load(BaseLib::Systems::ICentral* central)
 				_address = parameterIterator->second.rpcParameter->convertFromPacket(parameterData, parameterIterator->second.mainRole(), false)->booleanValue;
 			}
 		}
+		loadTransmitPriority();
+		loadRemoteAddresses();
 
 		return true;
 	}
@@ -390,6 +750,49 @@ bool MyPeer::load(BaseLib::Systems::ICentral* central)
     return false;
 }
 
+void MyPeer::loadRemoteAddresses()
+{
+	try
+	{
+		std::vector<int32_t> addresses;
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = configCentral.find(0);
+		if(channelIterator != configCentral.end())
+		{
+			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find("REMOTE_ADDRESSES");
+			if(parameterIterator != channelIterator->second.end() && parameterIterator->second.rpcParameter)
+			{
+				std::vector<uint8_t> parameterData = parameterIterator->second.getBinaryData();
+				std::string value = parameterIterator->second.rpcParameter->convertFromPacket(parameterData, parameterIterator->second.mainRole(), false)->stringValue;
+				if(!RemoteAddressIndex::parse(value, addresses)) GD::out.printWarning("Warning: REMOTE_ADDRESSES of peer " + std::to_string(_peerID) + " contains invalid addresses: " + value);
+			}
+		}
+		std::lock_guard<std::mutex> remoteAddressesGuard(_remoteAddressesMutex);
+		_remoteAddresses = addresses;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void MyPeer::loadTransmitPriority()
+{
+	try
+	{
+		_transmitPriority = TransmitPriority::normal;
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = configCentral.find(0);
+		if(channelIterator == configCentral.end()) return;
+		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find("TRANSMIT_PRIORITY");
+		if(parameterIterator == channelIterator->second.end() || !parameterIterator->second.rpcParameter) return;
+		std::vector<uint8_t> parameterData = parameterIterator->second.getBinaryData();
+		if(parameterIterator->second.rpcParameter->convertFromPacket(parameterData, parameterIterator->second.mainRole(), false)->integerValue > 0) _transmitPriority = TransmitPriority::high;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
 PParameterGroup MyPeer::getParameterSet(int32_t channel, ParameterGroup::Type::Enum type)
 {
 	try
@@ -410,16 +813,7 @@ bool MyPeer::getAllValuesHook2(PRpcClientInfo clientInfo, PParameter parameter,
 {
 	try
 	{
-		if(channel == 1)
-		{
-			if(parameter->id == "PEER_ID")
-			{
-				std::vector<uint8_t> parameterData;
-				auto& rpcConfigurationParameter = valuesCentral[channel][parameter->id];
-				parameter->convertToPacket(PVariable(new Variable((int32_t)_peerID)), rpcConfigurationParameter.mainRole(), parameterData);
-                rpcConfigurationParameter.setBinaryData(parameterData);
-			}
-		}
+		if(channel == 1 && _encodedPeerId != _peerID) encodePeerId();
 	}
 	catch(const std::exception& ex)
     {
@@ -432,16 +826,7 @@ bool MyPeer::getParamsetHook2(PRpcClientInfo clientInfo, PParameter parameter, u
 {
 	try
 	{
-		if(channel == 1)
-		{
-			if(parameter->id == "PEER_ID")
-			{
-				std::vector<uint8_t> parameterData;
-                auto& rpcConfigurationParameter = valuesCentral[channel][parameter->id];
-				parameter->convertToPacket(PVariable(new Variable((int32_t)_peerID)), rpcConfigurationParameter.mainRole(), parameterData);
-                rpcConfigurationParameter.setBinaryData(parameterData);
-			}
-		}
+		if(channel == 1 && _encodedPeerId != _peerID) encodePeerId();
 	}
 	catch(const std::exception& ex)
     {
@@ -451,6 +836,12 @@ bool MyPeer::getParamsetHook2(PRpcClientInfo clientInfo, PParameter parameter, u
 }
 
 PVariable MyPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing)
+{
+	if(!GD::commandExecutor) return processPutParamset(clientInfo, channel, type, remoteID, remoteChannel, variables, checkAcls, onlyPushing);
+	return GD::commandExecutor->run<PVariable>(_strand, [&]() { return processPutParamset(clientInfo, channel, type, remoteID, remoteChannel, variables, checkAcls, onlyPushing); });
+}
+
+PVariable MyPeer::processPutParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing)
 {
 	try
 	{
@@ -487,6 +878,14 @@ PVariable MyPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channe
 				GD::out.printInfo("Info: Parameter " + i->first + " of peer " + std::to_string(_peerID) + " and channel " + std::to_string(channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(parameterData) + ".");
 			}
 
+			if(parameterChanged) markChanged();
+			if(parameterChanged && channel == 0)
+			{
+				loadTransmitPriority();
+				loadRemoteAddresses();
+				std::shared_ptr<MyCentral> central = std::dynamic_pointer_cast<MyCentral>(getCentral());
+				if(central) central->setRemoteAddresses(_peerID, getRemoteAddresses());
+			}
 			if(parameterChanged) raiseRPCUpdateDevice(_peerID, channel, _serialNumber + ":" + std::to_string(channel), 0);
 		}
 		else if(type == ParameterGroup::Type::Enum::variables)
@@ -533,22 +932,47 @@ PVariable MyPeer::setInterface(BaseLib::PRpcClientInfo clientInfo, std::string i
 }
 
 PVariable MyPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait)
+{
+	if(!GD::commandExecutor) return processSetValue(clientInfo, channel, valueKey, value, wait);
+	return GD::commandExecutor->run<PVariable>(_strand, [&]() { return processSetValue(clientInfo, channel, valueKey, value, wait); });
+}
+
+PVariable MyPeer::processSetValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait)
 {
 	try
 	{
+		//{"VALUE": true, "PRIORITY": 1} sends a single command with a different priority than configured in TRANSMIT_PRIORITY.
+		TransmitPriority priority = _transmitPriority;
+		if(value && value->type == VariableType::tStruct)
+		{
+			Struct::iterator priorityIterator = value->structValue->find("PRIORITY");
+			if(priorityIterator != value->structValue->end()) priority = priorityIterator->second->integerValue > 0 ? TransmitPriority::high : TransmitPriority::normal;
+			Struct::iterator valueIterator = value->structValue->find("VALUE");
+			value = valueIterator != value->structValue->end() ? valueIterator->second : std::make_shared<Variable>(true);
+		}
+
 		Peer::setValue(clientInfo, channel, valueKey, value, wait); //Ignore result, otherwise setHomegerValue might not be executed
 		if(_disposing) return Variable::createError(-32500, "Peer is disposing.");
 		std::shared_ptr<MyCentral> central = std::dynamic_pointer_cast<MyCentral>(getCentral());
 		if(!central) return Variable::createError(-32500, "Could not get central object.");;
 		if(valueKey.empty()) return Variable::createError(-5, "Value key is empty.");
 		if(channel == 0 && serviceMessages->set(valueKey, value->booleanValue)) return PVariable(new Variable(VariableType::tVoid));
-		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(channel);
-		if(channelIterator == valuesCentral.end()) return Variable::createError(-2, "Unknown channel.");
-		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(valueKey);
-		if(parameterIterator == valuesCentral[channel].end()) return Variable::createError(-5, "Unknown parameter.");
-		PParameter rpcParameter = parameterIterator->second.rpcParameter;
+		//The key is only looked up by name once. Everything below works on the handle resolved at load time.
+		ParameterHandle* handle = getParameterHandle(channel, getParameterIndex(valueKey));
+		ParameterHandle genericHandle;
+		if(!handle)
+		{
+			//Parameters the module doesn't handle itself (e. g. service messages)
+			std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(channel);
+			if(channelIterator == valuesCentral.end()) return Variable::createError(-2, "Unknown channel.");
+			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(valueKey);
+			if(parameterIterator == channelIterator->second.end()) return Variable::createError(-5, "Unknown parameter.");
+			genericHandle.parameter = &parameterIterator->second;
+			handle = &genericHandle;
+		}
+		PParameter rpcParameter = handle->parameter->rpcParameter;
 		if(!rpcParameter) return Variable::createError(-5, "Unknown parameter.");
-		BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[channel][valueKey];
+		BaseLib::Systems::RpcConfigurationParameter& parameter = *handle->parameter;
 		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>());
 		std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable>());
 		if(rpcParameter->readable)
@@ -573,68 +997,61 @@ PVariable MyPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel,
 		}
 		else if(rpcParameter->physical->operationType != IPhysical::OperationType::Enum::command) return Variable::createError(-6, "Parameter is not settable.");
 
+		//Decided before anything is saved or a rolling code is used up, so callers can defer the command or shed load.
+		TransmitQueue::Admission admission;
+		if(handle->controlCode != 0)
+		{
+			if(!_physicalInterface) return Variable::createError(-10, "Peer has no physical interface.");
+			admission = _physicalInterface->admit(priority);
+			if(admission.result == TransmitQueue::Admission::Result::rejected)
+			{
+				Logging::info(GD::out, [&]() { return "Info: Not sending " + valueKey + " to peer " + std::to_string(_peerID) + ": " + admission.reason; });
+				if(admission.linkDown) return Variable::createError(-10, "Interface is not available: " + admission.reason);
+				return Variable::createError(-11, "Interface is busy: " + admission.reason);
+			}
+		}
+
 		std::vector<uint8_t> parameterData;
 		rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
 		parameter.setBinaryData(parameterData);
 		if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
 		else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
-		if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + valueKey + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(parameterData) + ".");
+		Logging::info(GD::out, [&]() { return "Info: " + valueKey + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(parameterData) + "."; });
 		value = rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
 
-		PMyPacket packet;
-
-		if(valueKey == "MY")
+		//Multi-channel remotes send each channel with the channel's own address, rolling code and key.
+		RemoteChannel* remoteChannel = nullptr;
+		if(!_remoteChannels.empty() && handle->controlCode != 0)
 		{
-		    std::string payload = 
-		            BaseLib::HelperFunctions::getHexString(_encryptionKey, 2) + 
-		            "10" + 
-		            BaseLib::HelperFunctions::getHexString(_rollingCode, 4) + 
-		            BaseLib::HelperFunctions::getHexString(_address, 6);
-			packet.reset(new MyPacket(payload));
-		}
-		if(valueKey == "UP")
-		{
-		    std::string payload = 
-		            BaseLib::HelperFunctions::getHexString(_encryptionKey, 2) + 
-		            "20" + 
-		            BaseLib::HelperFunctions::getHexString(_rollingCode, 4) + 
-		            BaseLib::HelperFunctions::getHexString(_address, 6);
-			packet.reset(new MyPacket(payload));
-		}
-		if(valueKey == "DOWN")
-		{
-		    std::string payload = 
-		            BaseLib::HelperFunctions::getHexString(_encryptionKey, 2) + 
-		            "40" + 
-		            BaseLib::HelperFunctions::getHexString(_rollingCode, 4) + 
-		            BaseLib::HelperFunctions::getHexString(_address, 6);
-			packet.reset(new MyPacket(payload));
+			if(channel == 0 || channel > _remoteChannels.size()) return Variable::createError(-2, "Unknown channel.");
+			remoteChannel = &_remoteChannels[channel - 1];
 		}
-		if(valueKey == "PROG")
+		uint32_t address = remoteChannel ? remoteChannel->address : _address;
+
+		PMyPacket packet;
+		if(handle->controlCode != 0)
 		{
-		    std::string payload = 
-		            BaseLib::HelperFunctions::getHexString(_encryptionKey, 2) + 
-		            "80" + 
-		            BaseLib::HelperFunctions::getHexString(_rollingCode, 4) + 
-		            BaseLib::HelperFunctions::getHexString(_address, 6);
+			//The code is reserved before the frame is built, so concurrent commands for the same address never share a code.
+			RollingCode::Value code = remoteChannel ? remoteChannel->rollingCode.reserve() : _rollingCode.reserve();
+			std::string payload =
+					BaseLib::HelperFunctions::getHexString(code.encryptionKey, 2) +
+					BaseLib::HelperFunctions::getHexString(handle->controlCode << 4, 2) +
+					BaseLib::HelperFunctions::getHexString(code.rollingCode, 4) +
+					BaseLib::HelperFunctions::getHexString(address, 6);
 			packet.reset(new MyPacket(payload));
-		}
+			packet->setSenderAddress(address);
+			packet->setRollingCode(code.rollingCode);
+			packet->setPriority(priority);
+			//A newer movement replaces one still waiting in the transmit queue. PROG only does so when configured.
+			if(handle->commandClass == RtsCommandClass::movement || (handle->commandClass == RtsCommandClass::prog && GD::supersedeProg)) packet->setSupersedeGroup((int32_t)handle->commandClass);
 
-		if(packet) 
-		{
-		    _physicalInterface->sendPacket(packet);
-		    uint32_t rollingCode = _rollingCode;
-		    uint32_t encryptionKey = _encryptionKey;
-		    
-		    if(rollingCode == 0xffff)
-		        rollingCode = 0;
-		    else
-		        rollingCode++;
-		    encryptionKey = ((encryptionKey & 0xAF) + 1) & 0xAF;
-		    setRollingCode(rollingCode);
-		    setEncryptionKey(encryptionKey);
+			//Saved before sending: After a crash the remote must not reuse a code the motor has already seen.
+			if(remoteChannel) saveRemoteChannels();
+			else saveRollingCode();
 		}
 
+		if(packet) _physicalInterface->sendPacket(packet);
+
 		if(!valueKeys->empty())
 		{
             std::string address(_serialNumber + ":" + std::to_string(channel));
@@ -642,6 +1059,14 @@ PVariable MyPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel,
             raiseRPCEvent(clientInfo->initInterfaceId, _peerID, channel, address, valueKeys, values);
 		}
 
+		if(admission.result == TransmitQueue::Admission::Result::queued)
+		{
+			//ETA is in milliseconds, -1 while the interface is disconnected.
+			PVariable result = std::make_shared<Variable>(VariableType::tStruct);
+			result->structValue->emplace("QUEUED", std::make_shared<Variable>(true));
+			result->structValue->emplace("ETA", std::make_shared<Variable>(admission.eta));
+			return result;
+		}
 		return PVariable(new Variable(VariableType::tVoid));
 	}
 	catch(const std::exception& ex)
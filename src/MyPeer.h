@@ -31,11 +31,17 @@
 #ifndef MYPEER_H_
 #define MYPEER_H_
 
+#include "InterfaceSelector.h"
 #include "MyPacket.h"
+#include "RtsCommands.h"
+#include "RollingCode.h"
+#include "StrandExecutor.h"
 #include <homegear-base/BaseLib.h>
 
 #include "PhysicalInterfaces/ISomfyInterface.h"
 
+#include <array>
+
 using namespace BaseLib;
 using namespace BaseLib::DeviceDescription;
 
@@ -46,6 +52,25 @@ class MyCentral;
 class MyPeer : public BaseLib::Systems::Peer, public BaseLib::Rpc::IWebserverEventSink
 {
 public:
+	struct DeviceType
+	{
+		enum Enum : uint32_t
+		{
+			rtsSwitch = 0x01,
+			rtsMultiRemote = 0x02 //One peer with one RTS remote per channel
+		};
+	};
+
+	/**
+	 * One channel of a multi-channel remote. Each channel is an RTS remote of its own. All channels are stored together
+	 * in one binary peer variable using 6 bytes per channel.
+	 */
+	struct RemoteChannel
+	{
+		uint32_t address = 0;
+		RollingCode rollingCode;
+	};
+
 	MyPeer(uint32_t parentID, IPeerEventSink* eventHandler);
 	MyPeer(int32_t id, int32_t address, std::string serialNumber, uint32_t parentID, IPeerEventSink* eventHandler);
 	virtual ~MyPeer();
@@ -58,19 +83,97 @@ public:
 
 	//{{{ In table variables
 	std::string getPhysicalInterfaceId();
+
+	/**
+	 * Returns the interface set for the peer or an empty string if it uses the default one. Unlike getPhysicalInterfaceId()
+	 * it doesn't assign and save the default interface.
+	 */
+	std::string getAssignedPhysicalInterfaceId() { return _physicalInterfaceId; }
 	void setPhysicalInterfaceId(std::string);
-	uint32_t getRollingCode() { return _rollingCode; }
+	uint32_t getRollingCode() { return _rollingCode.get().rollingCode; }
 	void setRollingCode(uint32_t code);
-	uint32_t getEncryptionKey() { return _encryptionKey; }
+	uint32_t getEncryptionKey() { return _rollingCode.get().encryptionKey; }
 	void setEncryptionKey(uint32_t key);
+
+	/**
+	 * Sets rolling code and key together, so they are only saved once.
+	 */
+	void setRollingCode(uint32_t code, uint32_t key);
+	//}}}
+
+	//{{{ Multi-channel remotes
+	/**
+	 * Returns the rolling code and key of every channel, starting with channel 1. Empty for single remotes.
+	 */
+	std::vector<RollingCode::Value> getRemoteChannelCodes();
+
+	/**
+	 * Sets the rolling codes and keys returned by getRemoteChannelCodes(). Channels missing in "codes" are left unchanged.
+	 */
+	void setRemoteChannelCodes(const std::vector<RollingCode::Value>& codes);
+	//}}}
+
+	virtual void setName(std::string name);
+	virtual void setName(int32_t channel, std::string name);
+
+	//{{{ Change tracking
+	/**
+	 * Called by everything changing what save() writes, so MyCentral::savePeers() can skip unchanged peers.
+	 */
+	void markChanged() { _changeGeneration++; }
+	bool hasChanges() { return _changeGeneration != _savedGeneration; }
+
+	/**
+	 * Saves the peer if it was changed since the last call. Changes made while saving are saved by the next call.
+	 *
+	 * @return Returns false if there was nothing to save.
+	 */
+	bool saveChanges();
 	//}}}
 
+	/**
+	 * Returns the number of RTS addresses used by this peer, starting at the peer's address.
+	 */
+	uint32_t getAddressCount();
+
 	std::shared_ptr<ISomfyInterface>& getPhysicalInterface() { return _physicalInterface; }
+	const std::shared_ptr<StrandExecutor::Strand>& getStrand() { return _strand; }
+
+	//{{{ Signal strength
+	typedef InterfaceSelector::Statistics RssiStatistics;
+
+	/**
+	 * Called for every copy of a frame received with one of the peer's addresses or one of its REMOTE_ADDRESSES, including
+	 * copies received by more than one interface. Updates the statistics of the receiving interface.
+	 */
+	void rssiReceived(const std::string& interfaceId, PMyPacket packet);
+
+	/**
+	 * Called once per frame received with one of the peer's addresses or one of its REMOTE_ADDRESSES. Runs on the peer's
+	 * strand of GD::commandExecutor. Updates RSSI_DEVICE and, when "autoSelectInterface" is enabled, switches to the
+	 * interface hearing the peer best.
+	 */
+	void frameReceived(const std::string& interfaceId, PMyPacket packet);
+	std::map<std::string, RssiStatistics> getRssiStatistics();
+
+	/**
+	 * Returns true if the frame carries one of the last rolling codes this module sent with the address. culfw doesn't
+	 * receive its own transmissions, so such frames are copies received by the other interfaces.
+	 */
+	bool isOwnFrame(int32_t address, uint16_t rollingCode);
+
+	/**
+	 * Returns the addresses of the physical remotes paired with the same motors (REMOTE_ADDRESSES in the config paramset
+	 * of channel 0). Their frames are received where the motors are, so they feed the interface selection.
+	 */
+	std::vector<int32_t> getRemoteAddresses();
+	//}}}
 
 	virtual std::string handleCliCommand(std::string command);
 
 	virtual bool load(BaseLib::Systems::ICentral* central);
     virtual void savePeers() {}
+    virtual void initializeCentralConfig();
 
 	virtual int32_t getChannelGroupedWith(int32_t channel) { return -1; }
 	virtual int32_t getNewFirmwareVersion() { return 0; }
@@ -90,20 +193,82 @@ public:
     virtual void homegearShuttingDown();
 
 	//RPC methods
+	/**
+	 * Runs on the peer's strand of GD::commandExecutor, see setValue().
+	 */
 	virtual PVariable putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing = false);
 	PVariable setInterface(BaseLib::PRpcClientInfo clientInfo, std::string interfaceId);
+
+	/**
+	 * Runs on the peer's strand of GD::commandExecutor and waits for the result. Commands for this peer are processed in
+	 * the order they were received, commands for different peers in parallel.
+	 */
 	virtual PVariable setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait);
 	//End RPC methods
 protected:
+	/**
+	 * The parameters the module handles itself. They are resolved to a ParameterHandle once when the peer is loaded,
+	 * so only the RPC boundary needs to look them up by name. The RTS commands follow "command" in the order of
+	 * rtsCommands.
+	 */
+	enum class ParameterId : int32_t
+	{
+		none = -1,
+		peerId = 0,
+		rollingCode,
+		encryptionKey,
+		rssiDevice,
+		command
+	};
+	static const size_t parameterHandleCount = (size_t)ParameterId::command + rtsCommandCount;
+
+	//Kept for every parameter of every channel, so it's kept small: The description is taken from parameter->rpcParameter.
+	struct ParameterHandle
+	{
+		BaseLib::Systems::RpcConfigurationParameter* parameter = nullptr;
+		uint8_t controlCode = 0; //Only set for RTS commands
+		RtsCommandClass commandClass = RtsCommandClass::other;
+	};
+
 	//In table variables:
 	std::string _physicalInterfaceId;
-	uint32_t _rollingCode;
-	uint32_t _encryptionKey;
+	RollingCode _rollingCode; //Also holds the encryption key
+	std::vector<RemoteChannel> _remoteChannels; //Indexed by channel - 1, only used by multi-channel remotes
 	//End
 
 	bool _shuttingDown = false;
+	//Codes are reserved without a lock. This only orders saving them, so the last save always writes the latest code.
+	std::mutex _rollingCodeSaveMutex;
+	std::atomic<uint64_t> _changeGeneration{0};
+	std::atomic<uint64_t> _savedGeneration{0};
+	std::shared_ptr<StrandExecutor::Strand> _strand;
 	std::shared_ptr<ISomfyInterface> _physicalInterface;
-	uint32_t _lastRssiDevice = 0;
+	int32_t _lastRssiDevice = 0;
+	InterfaceSelector _interfaceSelector;
+	std::mutex _remoteAddressesMutex;
+	std::vector<int32_t> _remoteAddresses; //From REMOTE_ADDRESSES in the config paramset of channel 0
+	TransmitPriority _transmitPriority = TransmitPriority::normal; //From TRANSMIT_PRIORITY in the config paramset of channel 0
+
+	//Indexed by channel and parameter index (see ParameterId). Points into valuesCentral, which is never erased from after initialization.
+	std::vector<std::array<ParameterHandle, parameterHandleCount>> _parameterHandles;
+	uint64_t _encodedPeerId = 0;
+
+	static int32_t getParameterIndex(const std::string& valueKey);
+	void initializeParameterHandles();
+	ParameterHandle* getParameterHandle(uint32_t channel, int32_t parameterIndex);
+	ParameterHandle* getParameterHandle(uint32_t channel, ParameterId parameterId) { return getParameterHandle(channel, (int32_t)parameterId); }
+	void encodePeerId();
+	void saveParameterHandle(ParameterHandle& handle, uint32_t channel, int32_t value);
+	uint32_t getRemoteChannelCount();
+	void initializeRemoteChannels();
+	void loadRemoteChannels(const std::vector<char>& data);
+	void saveRemoteChannels();
+	void saveRollingCode();
+	void loadTransmitPriority();
+	void loadRemoteAddresses();
+	void selectInterface();
+	PVariable processPutParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing);
+	PVariable processSetValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait);
 
 	virtual void loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<BaseLib::Database::DataTable>& rows);
     virtual void saveVariables();
@@ -0,0 +1,157 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Coc.h"
+#include "../GD.h"
+#include "../MyPacket.h"
+
+namespace MyFamily
+{
+
+Coc::Coc(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : ISomfyInterface(settings)
+{
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "COC \"" + settings->id + "\": ");
+
+	if(!settings->gpio.empty()) _out.printInfo("Info: GPIO settings are ignored. The board is used as started by its firmware.");
+
+	_connection = CocConnection::get(settings);
+	_stopped = true;
+}
+
+Coc::~Coc()
+{
+	try
+	{
+		stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Coc::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet)
+{
+	try
+	{
+		std::shared_ptr<MyPacket> myPacket(std::dynamic_pointer_cast<MyPacket>(packet));
+		if(!myPacket) return;
+
+		if(_stopped)
+		{
+			_out.printWarning("Warning: !!!Not!!! sending packet, because the interface is not started: " + myPacket->culHexString());
+			myPacket->setResult(TransmitResult::dropped);
+			return;
+		}
+
+		std::string data = "Ys" + myPacket->culHexString() + "\n";
+		if(!_connection->isOpen()) Logging::warning(_out, _queueingLogLimiter, [&]() { return "Warning: Device is not connected. Queueing packet until it is back: " + myPacket->culHexString(); });
+		//Logged, recorded and counted as sent by frameWritten() when the connection actually writes the frame.
+		_connection->send(_settings->stackPosition, data, myPacket);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+TransmitQueue::Admission Coc::admit(TransmitPriority priority)
+{
+	TransmitQueue::Admission admission = ISomfyInterface::admit(priority);
+	if(admission.result == TransmitQueue::Admission::Result::rejected) return admission;
+	return _connection->admit(priority);
+}
+
+void Coc::initCompleted()
+{
+	_connection->initCompleted();
+}
+
+bool Coc::sendCommand(const std::string& command)
+{
+	return _connection->sendCommand(_settings->stackPosition, command);
+}
+
+void Coc::startListening()
+{
+	try
+	{
+		stopListening();
+		resetStartupTime();
+		if(!_connection->addInterface(_settings->stackPosition, this)) return;
+		_stopped = false;
+		IPhysicalInterface::startListening();
+		_health->start();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Coc::stopListening()
+{
+	try
+	{
+		if(_stopped) return;
+		_connection->removeInterface(_settings->stackPosition);
+		_stopped = true;
+		_health->stop();
+		IPhysicalInterface::stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Coc::processPacket(std::string& packet)
+{
+	try
+	{
+		Logging::debug(_out, [&]() { return "Debug: Raw packet received: " + packet; });
+		if(processResponse(packet) || processFrame(packet)) return;
+
+		if(packet == "LOVF")
+		{
+			_connection->budgetExhausted();
+			Logging::warning(_out, _lovfLogLimiter, [&]() { return "Warning: COC with id " + _settings->id + " reached 1% limit. You need to wait, before sending is allowed again."; });
+		}
+		else Logging::info(_out, [&]() { return "Info: Unknown Somfy packet received: " + packet; });
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
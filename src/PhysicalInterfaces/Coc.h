@@ -0,0 +1,72 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef COC_H
+#define COC_H
+
+#include <homegear-base/BaseLib.h>
+#include "ISomfyInterface.h"
+#include "CocConnection.h"
+#include "../Logging.h"
+
+namespace MyFamily
+{
+
+/**
+ * COC, SCC, CSM and CCD boards running culfw, connected through a serial port. Stacked SCCs are configured as one
+ * interface per board using the same device.
+ */
+class Coc : public ISomfyInterface
+{
+public:
+	Coc(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings);
+	virtual ~Coc();
+	void startListening();
+	void stopListening();
+	virtual bool isOpen() { return !_stopped && _connection->isOpen(); }
+
+	void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet);
+	virtual TransmitQueue::Statistics getTransmitStatistics() { return _connection->getTransmitStatistics(); }
+	virtual TransmitQueue::Admission admit(TransmitPriority priority);
+	virtual TransmitQueue::DrainResult drain(int64_t deadline) { return _connection->drain(deadline); }
+protected:
+	//Shared by all interfaces stacked on the same serial port
+	std::shared_ptr<CocConnection> _connection;
+	LogRateLimiter _lovfLogLimiter;
+	LogRateLimiter _queueingLogLimiter;
+
+	virtual void processPacket(std::string& packet);
+	virtual bool sendCommand(const std::string& command);
+	virtual void initCompleted();
+};
+
+}
+#endif
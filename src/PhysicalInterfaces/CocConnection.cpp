@@ -0,0 +1,425 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "CocConnection.h"
+#include "ISomfyInterface.h"
+#include "../GD.h"
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace MyFamily
+{
+
+static const int32_t minReconnectDelay = 1000;
+static const int32_t maxReconnectDelay = 30000;
+//Opening a serial port can block for a long time when the device doesn't respond. It's done on a separate thread, so other interfaces aren't delayed.
+static const int32_t openTimeout = 5000;
+//Frames are written without blocking. Data the serial port doesn't take right away is written when it becomes writable.
+static const size_t maxWriteBufferSize = 4096;
+
+std::mutex CocConnection::_connectionsMutex;
+std::map<std::string, std::weak_ptr<CocConnection>> CocConnection::_connections;
+
+std::shared_ptr<CocConnection> CocConnection::get(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings)
+{
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	std::shared_ptr<CocConnection> connection = _connections[settings->device].lock();
+	if(!connection)
+	{
+		connection.reset(new CocConnection(settings));
+		_connections[settings->device] = connection;
+	}
+	else if(connection->_settings->baudrate != settings->baudrate) GD::out.printWarning("Warning: Interfaces using " + settings->device + " have different baud rates. Using the baud rate of interface \"" + connection->_settings->id + "\".");
+	return connection;
+}
+
+CocConnection::CocConnection(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : _transmitQueue(_out, [this](const TransmitQueue::Frame& frame) { return writeFrame(frame); }, [this](int32_t timeout) { GD::reactor->setTimer(this, timeout); })
+{
+	_settings = settings;
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "COC " + settings->device + ": ");
+
+	switch(settings->baudrate)
+	{
+	case 0:
+	case 38400:
+		_baudrate = LibSerial::BaudRate::BAUD_38400;
+		break;
+	case 9600:
+		_baudrate = LibSerial::BaudRate::BAUD_9600;
+		break;
+	case 19200:
+		_baudrate = LibSerial::BaudRate::BAUD_19200;
+		break;
+	case 57600:
+		_baudrate = LibSerial::BaudRate::BAUD_57600;
+		break;
+	case 115200:
+		_baudrate = LibSerial::BaudRate::BAUD_115200;
+		break;
+	default:
+		_out.printWarning("Warning: Invalid baudrate, defaulting to 38400.");
+		break;
+	}
+}
+
+CocConnection::~CocConnection()
+{
+	try
+	{
+		GD::reactor->removeHandler(this);
+		{
+			std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+			GD::bl->threadManager.join(_openThread);
+		}
+		closeDevice();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool CocConnection::addInterface(uint32_t stackPosition, ISomfyInterface* interface)
+{
+	try
+	{
+		std::lock_guard<std::mutex> listenGuard(_listenMutex);
+		if(!_demultiplexer.addInterface(stackPosition, interface))
+		{
+			_out.printError("Error: Stack position " + std::to_string(stackPosition) + " is used by more than one interface.");
+			return false;
+		}
+		if(_demultiplexer.interfaceCount() == 1) startListening();
+		else if(_open) writeFrame(interface->startInit(StackDemultiplexer::getStackPrefix(stackPosition)));
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void CocConnection::removeInterface(uint32_t stackPosition)
+{
+	try
+	{
+		std::lock_guard<std::mutex> listenGuard(_listenMutex);
+		if(_demultiplexer.removeInterface(stackPosition) == 0) stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool CocConnection::send(uint32_t stackPosition, const std::string& data, std::shared_ptr<MyPacket> packet)
+{
+	//Frames are held back while the devices are initialized.
+	return _transmitQueue.send(data, stackPosition, _open && _demultiplexer.initDone(), packet);
+}
+
+bool CocConnection::writeFrame(const std::string& data)
+{
+	try
+	{
+		//Returns before locking, so the health probe on the reactor thread doesn't wait for the device being opened.
+		if(!_open) return false;
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		if(!_open || _serialDescriptor == -1) return false;
+		if(_writeBuffer.size() + data.size() > maxWriteBufferSize)
+		{
+			_out.printWarning("Warning: Device doesn't take data fast enough.");
+			return false;
+		}
+		if(!_writeBuffer.empty())
+		{
+			//Keep the order of the data not written yet.
+			_writeBuffer.append(data);
+			return true;
+		}
+		ssize_t bytesWritten = write(_serialDescriptor, data.data(), data.size());
+		if(bytesWritten == -1)
+		{
+			if(errno != EAGAIN && errno != EINTR) throw std::runtime_error(strerror(errno));
+			bytesWritten = 0;
+		}
+		if((size_t)bytesWritten < data.size())
+		{
+			_writeBuffer.append(data, bytesWritten, std::string::npos);
+			GD::reactor->modifyDescriptor(_serialDescriptor, EPOLLIN | EPOLLOUT);
+		}
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printError("Error writing to " + _settings->device + ": " + std::string(ex.what()));
+	}
+	//The reactor reopens the device.
+	_open = false;
+	GD::reactor->setTimer(this, 0);
+	return false;
+}
+
+bool CocConnection::writeFrame(const TransmitQueue::Frame& frame)
+{
+	std::string data = StackDemultiplexer::getStackPrefix(frame.stackPosition) + frame.data;
+	if(!writeFrame(data)) return false;
+	_demultiplexer.frameWritten(frame.stackPosition, data, frame.packet);
+	return true;
+}
+
+bool CocConnection::writeBuffer()
+{
+	std::lock_guard<std::mutex> sendGuard(_sendMutex);
+	if(_serialDescriptor == -1) return true;
+	if(!_writeBuffer.empty())
+	{
+		ssize_t bytesWritten = write(_serialDescriptor, _writeBuffer.data(), _writeBuffer.size());
+		if(bytesWritten == -1)
+		{
+			if(errno == EAGAIN || errno == EINTR) return true;
+			_out.printError("Error writing to " + _settings->device + ": " + std::string(strerror(errno)));
+			return false;
+		}
+		_writeBuffer.erase(0, bytesWritten);
+	}
+	if(_writeBuffer.empty()) GD::reactor->modifyDescriptor(_serialDescriptor, EPOLLIN);
+	return true;
+}
+
+void CocConnection::startListening()
+{
+	try
+	{
+		if(_settings->device.empty())
+		{
+			_out.printError("Error: No device defined for COC. Please specify it in \"somfy.conf\".");
+			return;
+		}
+		_listening = true;
+		_reconnectDelay = minReconnectDelay;
+		GD::reactor->addHandler(this);
+		GD::reactor->setTimer(this, 0);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CocConnection::stopListening()
+{
+	try
+	{
+		_listening = false;
+		GD::reactor->removeHandler(this);
+		{
+			std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+			GD::bl->threadManager.join(_openThread);
+		}
+		closeDevice();
+		_transmitQueue.clear();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool CocConnection::reconnect()
+{
+	try
+	{
+		GD::reactor->removeDescriptor(_serialDescriptor);
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_serialDescriptor = -1;
+			_writeBuffer.clear();
+		}
+		//Opening can block. _serialPort is only used by this thread while the descriptor is -1, so _sendMutex isn't held.
+		if(_serialPort.IsOpen()) _serialPort.Close();
+		_out.printDebug("Debug: Opening " + _settings->device + "...");
+		_serialPort.Open(_settings->device);
+		_serialPort.SetBaudRate(_baudrate);
+		int32_t descriptor = _serialPort.GetFileDescriptor();
+		fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_serialDescriptor = descriptor;
+			_open = true;
+		}
+		if(!GD::reactor->addDescriptor(_serialDescriptor, EPOLLIN, this)) throw std::runtime_error("Could not watch the device.");
+		_out.printInfo("Info: Connected to " + _settings->device + ".");
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		if(_reconnectDelay <= minReconnectDelay) _out.printWarning("Warning: Could not open " + _settings->device + ": " + ex.what() + " Retrying in the background.");
+		else _out.printDebug("Debug: Could not open " + _settings->device + ": " + ex.what());
+	}
+	closeDevice();
+	return false;
+}
+
+void CocConnection::closeDevice()
+{
+	try
+	{
+		GD::reactor->removeDescriptor(_serialDescriptor);
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		_open = false;
+		_serialDescriptor = -1;
+		_writeBuffer.clear();
+		if(_serialPort.IsOpen()) _serialPort.Close();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CocConnection::initDevice()
+{
+	//The boards are started by the firmware without resetting them through GPIOs. The commands of all stacked devices are written at once instead of waiting for each device.
+	if(!writeFrame(_demultiplexer.startInit())) return;
+	_out.printDebug("Debug: Device initialization sent.");
+}
+
+void CocConnection::initCompleted()
+{
+	//Sends the frames held back on the reactor thread.
+	GD::reactor->setTimer(this, 0);
+}
+
+void CocConnection::timerExpired()
+{
+	try
+	{
+		if(!_listening) return;
+		if(_open)
+		{
+			if(!_demultiplexer.initDone()) GD::reactor->setTimer(this, _demultiplexer.initTimeLeft());
+			else _transmitQueue.flush();
+			return;
+		}
+		std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+		if(_opening)
+		{
+			if(!_openTimeoutReported && BaseLib::HelperFunctions::getTime() - _openStartTime >= openTimeout)
+			{
+				_out.printWarning("Warning: Opening " + _settings->device + " takes longer than " + std::to_string(openTimeout / 1000) + " seconds. Frames are queued until it's done.");
+				_openTimeoutReported = true;
+			}
+			return;
+		}
+		GD::bl->threadManager.join(_openThread);
+		_opening = true;
+		_openStartTime = BaseLib::HelperFunctions::getTime();
+		_openTimeoutReported = false;
+		//Replaced by openDevice() when it finishes in time.
+		GD::reactor->setTimer(this, openTimeout);
+		GD::bl->threadManager.start(_openThread, false, &CocConnection::openDevice, this);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CocConnection::openDevice()
+{
+	int32_t nextTimer = _reconnectDelay;
+	try
+	{
+		if(!reconnect()) _reconnectDelay = _reconnectDelay * 2 > maxReconnectDelay ? maxReconnectDelay : _reconnectDelay * 2;
+		else
+		{
+			_reconnectDelay = minReconnectDelay;
+			_demultiplexer.reset();
+			initDevice();
+			nextTimer = _demultiplexer.initTimeLeft();
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_opening = false;
+	if(_listening) GD::reactor->setTimer(this, nextTimer);
+}
+
+void CocConnection::descriptorEvent(int32_t descriptor, uint32_t events)
+{
+	try
+	{
+		if(descriptor != _serialDescriptor) return;
+		if((events & (EPOLLERR | EPOLLHUP)) || ((events & EPOLLOUT) && !writeBuffer()))
+		{
+			_out.printWarning("Warning: Connection to " + _settings->device + " lost. Trying to reconnect...");
+			closeDevice();
+			GD::reactor->setTimer(this, minReconnectDelay);
+			return;
+		}
+		if(!(events & EPOLLIN)) return;
+
+		std::vector<char> buffer(1024);
+		while(true)
+		{
+			ssize_t bytesRead = read(descriptor, buffer.data(), buffer.size());
+			if(bytesRead <= 0)
+			{
+				if(bytesRead == -1 && (errno == EAGAIN || errno == EINTR)) return;
+				_out.printWarning("Warning: Connection to " + _settings->device + " lost. Trying to reconnect...");
+				closeDevice();
+				GD::reactor->setTimer(this, minReconnectDelay);
+				return;
+			}
+
+			Logging::debug(_out, [&]() { return "Debug: Data received. Raw data: " + BaseLib::HelperFunctions::getHexString((uint8_t*)buffer.data(), bytesRead); }, 6);
+
+			//Recorded before it is split into lines, so a capture replays through the same demultiplexing.
+			_demultiplexer.recordReceived(buffer.data(), bytesRead);
+			_demultiplexer.processData(buffer.data(), bytesRead);
+			if((size_t)bytesRead < buffer.size()) return;
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
@@ -0,0 +1,153 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef COCCONNECTION_H_
+#define COCCONNECTION_H_
+
+#include <homegear-base/BaseLib.h>
+#include "StackDemultiplexer.h"
+#include "TransmitQueue.h"
+#include "Reactor.h"
+#include "../Logging.h"
+#include <libserial/SerialPort.h>
+
+namespace MyFamily
+{
+
+/**
+ * The serial port of a COC, SCC, CSM or CCD. Stacked SCCs share the UART of the lowest board, so all interfaces
+ * configured with the same device share one connection. It routes received lines to them by stack position, prefixes
+ * their outgoing frames and queues frames while the port is not available.
+ */
+class CocConnection : public Reactor::IEventHandler
+{
+public:
+	virtual ~CocConnection();
+
+	/**
+	 * Returns the connection for the device in the settings, creating it if necessary.
+	 */
+	static std::shared_ptr<CocConnection> get(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings);
+
+	/**
+	 * Starts routing lines to the interface. The first interface added opens the port.
+	 *
+	 * @return Returns false if another interface already uses the stack position.
+	 */
+	bool addInterface(uint32_t stackPosition, ISomfyInterface* interface);
+
+	/**
+	 * Stops routing lines to the interface. Removing the last interface closes the port.
+	 */
+	void removeInterface(uint32_t stackPosition);
+
+	bool isOpen() { return _open; }
+
+	/**
+	 * Writes a frame for the device at the given stack position or queues it until the port is available.
+	 *
+	 * @param data The frame including the line end, but without stack prefix.
+	 * @param packet Receives the result, see TransmitQueue::send().
+	 * @return Returns true if the frame was written, false if it was queued.
+	 */
+	bool send(uint32_t stackPosition, const std::string& data, std::shared_ptr<MyPacket> packet);
+
+	/**
+	 * The statistics of the queue shared by all stacked devices.
+	 */
+	TransmitQueue::Statistics getTransmitStatistics() { return _transmitQueue.getStatistics(); }
+
+	/**
+	 * Called when one of the stacked devices reported "LOVF". They share the budget of the lowest device.
+	 */
+	void budgetExhausted() { _transmitQueue.budgetExhausted(); }
+
+	TransmitQueue::Admission admit(TransmitPriority priority) { return _transmitQueue.admit(priority, isOpen()); }
+
+	TransmitQueue::DrainResult drain(int64_t deadline) { return _transmitQueue.drain(deadline, [this]() { return isOpen(); }); }
+
+	/**
+	 * Writes a culfw command for the device at the given stack position right away, bypassing the transmit queue.
+	 *
+	 * @param command The command including the line end, but without stack prefix.
+	 * @return Returns false if the command could not be written.
+	 */
+	bool sendCommand(uint32_t stackPosition, const std::string& command) { return writeFrame(StackDemultiplexer::getStackPrefix(stackPosition) + command); }
+
+	/**
+	 * Called by a stacked interface when it completed its initialization. Queued frames are sent once all are initialized.
+	 */
+	void initCompleted();
+private:
+	static std::mutex _connectionsMutex;
+	static std::map<std::string, std::weak_ptr<CocConnection>> _connections;
+
+	BaseLib::Output _out;
+	std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> _settings;
+	LibSerial::BaudRate _baudrate = LibSerial::BaudRate::BAUD_38400;
+	std::mutex _listenMutex;
+	std::mutex _sendMutex;
+	LibSerial::SerialPort _serialPort;
+	std::atomic_bool _listening{false};
+	std::atomic_bool _open{false};
+	int32_t _reconnectDelay = 0;
+	int32_t _serialDescriptor = -1;
+	std::string _writeBuffer;
+	StackDemultiplexer _demultiplexer;
+	TransmitQueue _transmitQueue;
+
+	std::mutex _openThreadMutex;
+	std::thread _openThread;
+	std::atomic_bool _opening{false};
+	int64_t _openStartTime = 0;
+	bool _openTimeoutReported = false;
+
+	CocConnection(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings);
+	void startListening();
+	void stopListening();
+	bool reconnect();
+	void openDevice();
+	void closeDevice();
+	void initDevice();
+	bool writeFrame(const std::string& data);
+
+	/**
+	 * Writes a frame of the transmit queue. Only a frame actually written is logged and recorded by its interface.
+	 */
+	bool writeFrame(const TransmitQueue::Frame& frame);
+	bool writeBuffer();
+	virtual void timerExpired();
+	virtual void descriptorEvent(int32_t descriptor, uint32_t events);
+};
+
+}
+
+#endif
@@ -33,119 +33,559 @@
 #include <homegear-base/BaseLib.h>
 #include "../GD.h"
 #include "../MyPacket.h"
+#include "../Logging.h"
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
 
 namespace MyFamily
 {
 
-Cul::Cul(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : ISomfyInterface(settings)
+static const int32_t minReconnectDelay = 1000;
+static const int32_t maxReconnectDelay = 30000;
+//Opening a serial port can block for a long time when the device doesn't respond. It's done on a separate thread, so other interfaces aren't delayed.
+static const int32_t openTimeout = 5000;
+//Frames are written without blocking. Data the serial port doesn't take right away is written when it becomes writable.
+static const size_t maxWriteBufferSize = 4096;
+
+Cul::Cul(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : ISomfyInterface(settings), _transmitQueue(_out, [this](const TransmitQueue::Frame& frame) { return writeFrame(frame.data); }, [this](int32_t timeout) { GD::reactor->setTimer(this, timeout); })
 {
 	_out.init(GD::bl);
 	_out.setPrefix(GD::out.getPrefix() + "CUL \"" + settings->id + "\": ");
-	LibSerial::BaudRate baudrate = LibSerial::BaudRate::BAUD_38400;
 	switch(settings->baudrate) {
 	case 50:
-		baudrate = LibSerial::BaudRate::BAUD_50;
+		_baudrate = LibSerial::BaudRate::BAUD_50;
 		break;
 	case 75:
-		baudrate = LibSerial::BaudRate::BAUD_75;
+		_baudrate = LibSerial::BaudRate::BAUD_75;
 		break;
 	case 110:
-		baudrate = LibSerial::BaudRate::BAUD_110;
+		_baudrate = LibSerial::BaudRate::BAUD_110;
 		break;
 	case 134:
-		baudrate = LibSerial::BaudRate::BAUD_134;
+		_baudrate = LibSerial::BaudRate::BAUD_134;
 		break;
 	case 150:
-		baudrate = LibSerial::BaudRate::BAUD_150;
+		_baudrate = LibSerial::BaudRate::BAUD_150;
 		break;
 	case 200:
-		baudrate = LibSerial::BaudRate::BAUD_200;
+		_baudrate = LibSerial::BaudRate::BAUD_200;
 		break;
 	case 300:
-		baudrate = LibSerial::BaudRate::BAUD_300;
+		_baudrate = LibSerial::BaudRate::BAUD_300;
 		break;
 	case 600:
-		baudrate = LibSerial::BaudRate::BAUD_600;
+		_baudrate = LibSerial::BaudRate::BAUD_600;
 		break;
 	case 1200:
-		baudrate = LibSerial::BaudRate::BAUD_1200;
+		_baudrate = LibSerial::BaudRate::BAUD_1200;
 		break;
 	case 1800:
-		baudrate = LibSerial::BaudRate::BAUD_1800;
+		_baudrate = LibSerial::BaudRate::BAUD_1800;
 		break;
 	case 2400:
-		baudrate = LibSerial::BaudRate::BAUD_2400;
+		_baudrate = LibSerial::BaudRate::BAUD_2400;
 		break;
 	case 4800:
-		baudrate = LibSerial::BaudRate::BAUD_4800;
+		_baudrate = LibSerial::BaudRate::BAUD_4800;
 		break;
 	case 9600:
-		baudrate = LibSerial::BaudRate::BAUD_9600;
+		_baudrate = LibSerial::BaudRate::BAUD_9600;
 		break;
 	case 19200:
-		baudrate = LibSerial::BaudRate::BAUD_19200;
+		_baudrate = LibSerial::BaudRate::BAUD_19200;
 		break;
 	case 38400:
-		baudrate = LibSerial::BaudRate::BAUD_38400;
+		_baudrate = LibSerial::BaudRate::BAUD_38400;
 		break;
 	case 57600:
-		baudrate = LibSerial::BaudRate::BAUD_57600;
+		_baudrate = LibSerial::BaudRate::BAUD_57600;
 		break;
 	case 115200:
-		baudrate = LibSerial::BaudRate::BAUD_115200;
+		_baudrate = LibSerial::BaudRate::BAUD_115200;
 		break;
 	case 230400:
-		baudrate = LibSerial::BaudRate::BAUD_230400;
+		_baudrate = LibSerial::BaudRate::BAUD_230400;
 		break;
 	case 460800:
-		baudrate = LibSerial::BaudRate::BAUD_460800;
+		_baudrate = LibSerial::BaudRate::BAUD_460800;
 		break;
 	case 500000:
-		baudrate = LibSerial::BaudRate::BAUD_500000;
+		_baudrate = LibSerial::BaudRate::BAUD_500000;
 		break;
 	case 576000:
-		baudrate = LibSerial::BaudRate::BAUD_576000;
+		_baudrate = LibSerial::BaudRate::BAUD_576000;
 		break;
 	case 921600:
-		baudrate = LibSerial::BaudRate::BAUD_921600;
+		_baudrate = LibSerial::BaudRate::BAUD_921600;
 		break;
 	case 1000000:
-		baudrate = LibSerial::BaudRate::BAUD_1000000;
+		_baudrate = LibSerial::BaudRate::BAUD_1000000;
 		break;
 	case 1152000:
-		baudrate = LibSerial::BaudRate::BAUD_1152000;
+		_baudrate = LibSerial::BaudRate::BAUD_1152000;
 		break;
 	case 1500000:
-		baudrate = LibSerial::BaudRate::BAUD_1500000;
+		_baudrate = LibSerial::BaudRate::BAUD_1500000;
 		break;
 	default:
     		_out.printWarning(std::string("Warning: invalid baudrate, defaulting to 38400."));
 		break;
 	}
-	sp.Open(settings->device);
-	sp.SetBaudRate(baudrate);
+
+	std::string::size_type slashPosition = settings->device.find_last_of('/');
+	if(slashPosition == std::string::npos)
+	{
+		_deviceDirectory = ".";
+		_deviceName = settings->device;
+	}
+	else
+	{
+		_deviceDirectory = slashPosition == 0 ? "/" : settings->device.substr(0, slashPosition);
+		_deviceName = settings->device.substr(slashPosition + 1);
+	}
 }
 
 
 Cul::~Cul()
 {
-	sp.Close();
+	try
+	{
+		GD::reactor->removeHandler(this);
+		{
+			std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+			GD::bl->threadManager.join(_openThread);
+		}
+		closeDevice(LinkState::closed);
+		if(_inotifyDescriptor != -1) close(_inotifyDescriptor);
+		_inotifyDescriptor = -1;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
 }
 
 void Cul::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet)
 {
-	std::shared_ptr<MyPacket> myPacket(std::dynamic_pointer_cast<MyPacket>(packet));
-	sp.Write("Ys" + myPacket->culHexString() + "\n");
+	try
+	{
+		std::shared_ptr<MyPacket> myPacket(std::dynamic_pointer_cast<MyPacket>(packet));
+		if(!myPacket) return;
+
+		std::string data = "Ys" + myPacket->culHexString() + "\n";
+
+		//Packets are held back while the device is initialized.
+		bool linkOpen = isOpen() && initDone();
+		if(!isOpen()) Logging::warning(_out, _queueingLogLimiter, [&]() { return "Warning: Device is not connected. Queueing packet until it is back: " + myPacket->culHexString(); });
+		else Logging::info(_out, [&]() { return "Info: Sending (" + _settings->id + "): " + myPacket->culHexString(); });
+		_transmitQueue.send(data, 0, linkOpen, myPacket);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+TransmitQueue::Admission Cul::admit(TransmitPriority priority)
+{
+	TransmitQueue::Admission admission = ISomfyInterface::admit(priority);
+	if(admission.result == TransmitQueue::Admission::Result::rejected) return admission;
+	return _transmitQueue.admit(priority, isOpen());
+}
+
+bool Cul::sendCommand(const std::string& command)
+{
+	return writeFrame(command);
+}
+
+bool Cul::writeFrame(const std::string& data)
+{
+	try
+	{
+		//Returns before locking, so the health probe on the reactor thread doesn't wait for the device being opened.
+		if(_linkState != LinkState::open) return false;
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		if(_linkState != LinkState::open || _serialDescriptor == -1) return false;
+		if(_writeBuffer.size() + data.size() > maxWriteBufferSize)
+		{
+			_out.printWarning("Warning: Device doesn't take data fast enough.");
+			return false;
+		}
+		record(TrafficRecorder::Direction::sent, data.data(), data.size());
+		_lastPacketSent = BaseLib::HelperFunctions::getTime();
+		if(!_writeBuffer.empty())
+		{
+			//Keep the order of the data not written yet.
+			_writeBuffer.append(data);
+			return true;
+		}
+		ssize_t bytesWritten = write(_serialDescriptor, data.data(), data.size());
+		if(bytesWritten == -1)
+		{
+			if(errno != EAGAIN && errno != EINTR) throw std::runtime_error(strerror(errno));
+			bytesWritten = 0;
+		}
+		if((size_t)bytesWritten < data.size())
+		{
+			_writeBuffer.append(data, bytesWritten, std::string::npos);
+			GD::reactor->modifyDescriptor(_serialDescriptor, EPOLLIN | EPOLLOUT);
+		}
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printError("Error writing to CUL: " + std::string(ex.what()));
+	}
+	//The reactor reopens the device.
+	_linkState = LinkState::failed;
+	GD::reactor->setTimer(this, 0);
+	return false;
 }
 
+bool Cul::writeBuffer()
+{
+	std::lock_guard<std::mutex> sendGuard(_sendMutex);
+	if(_serialDescriptor == -1) return true;
+	if(!_writeBuffer.empty())
+	{
+		ssize_t bytesWritten = write(_serialDescriptor, _writeBuffer.data(), _writeBuffer.size());
+		if(bytesWritten == -1)
+		{
+			if(errno == EAGAIN || errno == EINTR) return true;
+			_out.printError("Error writing to CUL: " + std::string(strerror(errno)));
+			return false;
+		}
+		_writeBuffer.erase(0, bytesWritten);
+	}
+	if(_writeBuffer.empty()) GD::reactor->modifyDescriptor(_serialDescriptor, EPOLLIN);
+	return true;
+}
 
 void Cul::startListening()
 {
-	IPhysicalInterface::startListening();
+	try
+	{
+		stopListening();
+		if(_settings->device.empty())
+		{
+			_out.printError("Error: No device defined for CUL. Please specify it in \"somfy.conf\".");
+			return;
+		}
+		_stopped = false;
+		resetStartupTime();
+		_reconnectDelay = minReconnectDelay;
+		GD::reactor->addHandler(this);
+		if(_inotifyDescriptor != -1) GD::reactor->addDescriptor(_inotifyDescriptor, EPOLLIN, this);
+		GD::reactor->setTimer(this, 0);
+		IPhysicalInterface::startListening();
+		_health->start();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
 }
 
 void Cul::stopListening()
 {
-	IPhysicalInterface::stopListening();
+	try
+	{
+		GD::reactor->removeHandler(this);
+		{
+			std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+			GD::bl->threadManager.join(_openThread);
+		}
+		closeDevice(LinkState::closed);
+		_stopped = true;
+		_health->stop();
+		IPhysicalInterface::stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool Cul::reconnect()
+{
+	try
+	{
+		watchDevice();
+		GD::reactor->removeDescriptor(_serialDescriptor);
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_serialDescriptor = -1;
+			_writeBuffer.clear();
+		}
+		//Opening can block. sp is only used by this thread while the descriptor is -1, so _sendMutex isn't held.
+		if(sp.IsOpen()) sp.Close();
+		_out.printDebug("Debug: Opening CUL device " + _settings->device + "...");
+		sp.Open(_settings->device);
+		sp.SetBaudRate(_baudrate);
+		int32_t descriptor = sp.GetFileDescriptor();
+		fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_serialDescriptor = descriptor;
+			_linkState = LinkState::open;
+		}
+		if(!GD::reactor->addDescriptor(_serialDescriptor, EPOLLIN, this)) throw std::runtime_error("Could not watch the device.");
+		_out.printInfo("Info: Connected to CUL device " + _settings->device + ".");
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		if(_reconnectDelay <= minReconnectDelay) _out.printWarning("Warning: Could not open CUL device " + _settings->device + ": " + ex.what() + " Retrying in the background.");
+		else _out.printDebug("Debug: Could not open CUL device " + _settings->device + ": " + ex.what());
+	}
+	closeDevice(LinkState::failed);
+	return false;
+}
+
+void Cul::closeDevice(LinkState state)
+{
+	try
+	{
+		if(state == LinkState::failed && _linkState == LinkState::open) _out.printWarning("Warning: Connection to CUL lost. Trying to reconnect...");
+		GD::reactor->removeDescriptor(_serialDescriptor);
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		_linkState = state;
+		_serialDescriptor = -1;
+		_writeBuffer.clear();
+		if(sp.IsOpen()) sp.Close();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Cul::initDevice()
+{
+	if(!writeFrame(startInit())) return;
+	_out.printDebug("Debug: CUL initialization sent.");
+}
+
+void Cul::initCompleted()
+{
+	//Sends the packets held back on the reactor thread.
+	GD::reactor->setTimer(this, 0);
+}
+
+void Cul::watchDevice()
+{
+	try
+	{
+		if(_inotifyDescriptor == -1)
+		{
+			_inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if(_inotifyDescriptor == -1)
+			{
+				_out.printWarning("Warning: Could not initialize inotify. Hot plugging is detected by polling only: " + std::string(strerror(errno)));
+				return;
+			}
+			GD::reactor->addDescriptor(_inotifyDescriptor, EPOLLIN, this);
+		}
+		if(_inotifyWatch != -1) return;
+		//Watch the directory, so the device node (or a by-id symlink) reappearing after an unplug is noticed.
+		_inotifyWatch = inotify_add_watch(_inotifyDescriptor, _deviceDirectory.c_str(), IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_TO | IN_MOVED_FROM);
+		if(_inotifyWatch == -1) _out.printDebug("Debug: Could not watch directory " + _deviceDirectory + ": " + std::string(strerror(errno)));
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool Cul::deviceChanged()
+{
+	if(_inotifyDescriptor == -1) return false;
+	bool changed = false;
+	std::vector<char> buffer(4096);
+	while(true)
+	{
+		ssize_t bytesRead = read(_inotifyDescriptor, buffer.data(), buffer.size());
+		if(bytesRead <= 0) break;
+		for(ssize_t i = 0; i < bytesRead;)
+		{
+			struct inotify_event* event = (struct inotify_event*)(buffer.data() + i);
+			if(event->mask & IN_IGNORED)
+			{
+				//The watched directory was removed (e. g. "/dev/serial/by-id" after unplugging the last USB serial device).
+				_inotifyWatch = -1;
+				changed = true;
+			}
+			else if(event->len > 0 && _deviceName == event->name) changed = true;
+			i += sizeof(struct inotify_event) + event->len;
+		}
+	}
+	return changed;
+}
+
+void Cul::timerExpired()
+{
+	try
+	{
+		if(_stopped) return;
+		if(_linkState == LinkState::open)
+		{
+			if(!initDone()) GD::reactor->setTimer(this, initTimeLeft());
+			else _transmitQueue.flush();
+			return;
+		}
+		std::lock_guard<std::mutex> openThreadGuard(_openThreadMutex);
+		if(_opening)
+		{
+			if(!_openTimeoutReported && BaseLib::HelperFunctions::getTime() - _openStartTime >= openTimeout)
+			{
+				_out.printWarning("Warning: Opening CUL device " + _settings->device + " takes longer than " + std::to_string(openTimeout / 1000) + " seconds. Packets are queued until it's done.");
+				_openTimeoutReported = true;
+			}
+			return;
+		}
+		GD::bl->threadManager.join(_openThread);
+		_opening = true;
+		_openStartTime = BaseLib::HelperFunctions::getTime();
+		_openTimeoutReported = false;
+		//Replaced by openDevice() when it finishes in time.
+		GD::reactor->setTimer(this, openTimeout);
+		GD::bl->threadManager.start(_openThread, false, &Cul::openDevice, this);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Cul::openDevice()
+{
+	int32_t nextTimer = _reconnectDelay;
+	try
+	{
+		if(!reconnect()) _reconnectDelay = _reconnectDelay * 2 > maxReconnectDelay ? maxReconnectDelay : _reconnectDelay * 2;
+		else
+		{
+			_reconnectDelay = minReconnectDelay;
+			{
+				std::lock_guard<std::mutex> receiveBufferGuard(_receiveBufferMutex);
+				_receiveBuffer.clear();
+			}
+			initDevice();
+			nextTimer = initTimeLeft();
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_opening = false;
+	if(!_stopped) GD::reactor->setTimer(this, nextTimer);
+}
+
+void Cul::descriptorEvent(int32_t descriptor, uint32_t events)
+{
+	try
+	{
+		if(descriptor == _inotifyDescriptor)
+		{
+			if(!deviceChanged()) return;
+			if(_linkState != LinkState::open)
+			{
+				//Give udev some time to set permissions.
+				GD::reactor->setTimer(this, 200);
+			}
+			else if(access(_settings->device.c_str(), F_OK) == -1)
+			{
+				closeDevice(LinkState::failed);
+				GD::reactor->setTimer(this, minReconnectDelay);
+			}
+			return;
+		}
+		if(descriptor != _serialDescriptor) return;
+
+		if((events & (EPOLLERR | EPOLLHUP)) || ((events & EPOLLOUT) && !writeBuffer()))
+		{
+			closeDevice(LinkState::failed);
+			GD::reactor->setTimer(this, minReconnectDelay);
+			return;
+		}
+		if(!(events & EPOLLIN)) return;
+
+		std::vector<uint8_t> buffer(1024);
+		while(true)
+		{
+			ssize_t bytesRead = read(descriptor, buffer.data(), buffer.size());
+			if(bytesRead <= 0)
+			{
+				if(bytesRead == -1 && (errno == EAGAIN || errno == EINTR)) return;
+				//A read returning 0 on a tty that signaled readability means the device is gone.
+				closeDevice(LinkState::failed);
+				GD::reactor->setTimer(this, minReconnectDelay);
+				return;
+			}
+
+			std::vector<uint8_t> data(buffer.begin(), buffer.begin() + bytesRead);
+			record(TrafficRecorder::Direction::received, (char*)data.data(), data.size());
+			processData(data);
+			_lastPacketReceived = BaseLib::HelperFunctions::getTime();
+			if((size_t)bytesRead < buffer.size()) return;
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Cul::processData(std::vector<uint8_t>& data)
+{
+	try
+	{
+		std::lock_guard<std::mutex> receiveBufferGuard(_receiveBufferMutex);
+		_receiveBuffer.append(data.begin(), data.end());
+		std::string::size_type lineEnd;
+		while((lineEnd = _receiveBuffer.find('\n')) != std::string::npos)
+		{
+			std::string packet = _receiveBuffer.substr(0, lineEnd);
+			_receiveBuffer.erase(0, lineEnd + 1);
+			processPacket(packet);
+		}
+		if(_receiveBuffer.size() > 1024)
+		{
+			_out.printError("Error: Could not read from CUL: Too much data without line break.");
+			_receiveBuffer.clear();
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Cul::processPacket(std::string& data)
+{
+	try
+	{
+		BaseLib::HelperFunctions::trim(data);
+		if(data.empty()) return;
+
+		Logging::debug(_out, [&]() { return "Debug: Raw packet received: " + data; });
+		if(processResponse(data) || processFrame(data)) return;
+
+		if(data == "LOVF")
+		{
+			_transmitQueue.budgetExhausted();
+			Logging::warning(_out, _lovfLogLimiter, [&]() { return "Warning: CUL with id " + _settings->id + " reached 1% limit. You need to wait, before sending is allowed again."; });
+		}
+		else Logging::info(_out, [&]() { return "Info: Unknown Somfy packet received: " + data; });
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
 }
 }
@@ -34,20 +34,73 @@
 
 #include <homegear-base/BaseLib.h>
 #include "ISomfyInterface.h"
+#include "TransmitQueue.h"
+#include "Reactor.h"
+#include "../Logging.h"
 #include <libserial/SerialPort.h>
 
 namespace MyFamily
 {
 
-class Cul: public ISomfyInterface
+class Cul: public ISomfyInterface, public Reactor::IEventHandler
 {
     public:
 	Cul(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings);
         virtual ~Cul();
         void startListening();
         void stopListening();
-        //virtual bool isOpen() { return _socket->connected(); }
+        virtual bool isOpen() { return _linkState == LinkState::open; }
 	void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet);
+        virtual TransmitQueue::Statistics getTransmitStatistics() { return _transmitQueue.getStatistics(); }
+        virtual TransmitQueue::Admission admit(TransmitPriority priority);
+        virtual TransmitQueue::DrainResult drain(int64_t deadline) { return _transmitQueue.drain(deadline, [this]() { return isOpen(); }); }
+    protected:
+        enum class LinkState : int32_t
+        {
+            closed = 0,
+            open = 1,
+            failed = 2
+        };
+
+        LibSerial::BaudRate _baudrate = LibSerial::BaudRate::BAUD_38400;
+        std::atomic<LinkState> _linkState{LinkState::closed};
+        int32_t _reconnectDelay = 0;
+        int32_t _serialDescriptor = -1;
+        std::string _writeBuffer;
+
+        TransmitQueue _transmitQueue;
+
+        int32_t _inotifyDescriptor = -1;
+        int32_t _inotifyWatch = -1;
+        std::string _deviceDirectory;
+        std::string _deviceName;
+
+        LogRateLimiter _lovfLogLimiter;
+        LogRateLimiter _queueingLogLimiter;
+
+        std::mutex _receiveBufferMutex;
+        std::string _receiveBuffer;
+
+        std::mutex _openThreadMutex;
+        std::thread _openThread;
+        std::atomic_bool _opening{false};
+        int64_t _openStartTime = 0;
+        bool _openTimeoutReported = false;
+
+        bool reconnect();
+        void openDevice();
+        void closeDevice(LinkState state);
+        void initDevice();
+        virtual void initCompleted();
+        void watchDevice();
+        bool deviceChanged();
+        bool writeFrame(const std::string& data);
+        virtual bool sendCommand(const std::string& command);
+        bool writeBuffer();
+        virtual void processData(std::vector<uint8_t>& data);
+        virtual void processPacket(std::string& data);
+        virtual void timerExpired();
+        virtual void descriptorEvent(int32_t descriptor, uint32_t events);
     private:
     	LibSerial::SerialPort sp;
 };
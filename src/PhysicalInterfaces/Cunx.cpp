@@ -32,6 +32,7 @@
 #include <homegear-base/BaseLib.h>
 #include "../GD.h"
 #include "../MyPacket.h"
+#include "../Logging.h"
 
 namespace MyFamily
 {
@@ -41,28 +42,21 @@ Cunx::Cunx(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings
 	_out.init(GD::bl);
 	_out.setPrefix(GD::out.getPrefix() + "CUNX \"" + settings->id + "\": ");
 
-	stackPrefix = "";
-	for (uint32_t i = 1; i < settings->stackPosition; i++) {
-	  stackPrefix.push_back('*');
-	}
-
-	signal(SIGPIPE, SIG_IGN);
-
-	_socket = std::unique_ptr<BaseLib::TcpSocket>(new BaseLib::TcpSocket(_bl));
-
 	if(settings->listenThreadPriority == -1)
 	{
 		settings->listenThreadPriority = 45;
 		settings->listenThreadPolicy = SCHED_FIFO;
 	}
+
+	_connection = CunxConnection::get(settings);
+	_stopped = true;
 }
 
 Cunx::~Cunx()
 {
 	try
 	{
-		_stopCallbackThread = true;
-		GD::bl->threadManager.join(_listenThread);
+		stopListening();
 	}
     catch(const std::exception& ex)
     {
@@ -77,16 +71,17 @@ void Cunx::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet)
 		std::shared_ptr<MyPacket> myPacket(std::dynamic_pointer_cast<MyPacket>(packet));
 		if(!myPacket) return;
 
-		if(!isOpen())
+		if(_stopped)
 		{
-			_out.printWarning(std::string("Warning: !!!Not!!! sending packet, because device is not connected or opened: ") + myPacket->culHexString());
+			_out.printWarning("Warning: !!!Not!!! sending packet, because the interface is not started: " + myPacket->culHexString());
+			myPacket->setResult(TransmitResult::dropped);
 			return;
 		}
 
-		_out.printInfo("Info: Sending (" + _settings->id + "): " + myPacket->culHexString());
-		send(stackPrefix + "Ys" + myPacket->culHexString() + "\n");
-		
-		_lastPacketSent = BaseLib::HelperFunctions::getTime();
+		std::string data = "Ys" + myPacket->culHexString() + "\n";
+		if(!_connection->isOpen()) Logging::warning(_out, _queueingLogLimiter, [&]() { return "Warning: Device is not connected. Queueing packet until it is back: " + myPacket->culHexString(); });
+		//Logged, recorded and counted as sent by frameWritten() when the connection actually writes the frame.
+		_connection->send(_settings->stackPosition, data, myPacket);
 	}
 	catch(const std::exception& ex)
     {
@@ -94,61 +89,35 @@ void Cunx::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet)
     }
 }
 
-void Cunx::send(std::string data)
+TransmitQueue::Admission Cunx::admit(TransmitPriority priority)
 {
-	try
-    {
-    	if(data.size() < 3) return; //Otherwise error in printWarning
-		std::lock_guard<std::mutex> sendGuard(_sendMutex);
-    	if(!_socket->connected() || _stopped)
-    	{
-    		_out.printWarning(std::string("Warning: !!!Not!!! sending: ") + data.substr(2, data.size() - 3));
-    		return;
-    	}
-    	_socket->proofwrite(data);
-    	 return;
-    }
-    catch(const BaseLib::SocketOperationException& ex)
-    {
-    	_out.printError(ex.what());
-    }
-    catch(const std::exception& ex)
-    {
-    	_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    }
-    _stopped = true;
+	TransmitQueue::Admission admission = ISomfyInterface::admit(priority);
+	if(admission.result == TransmitQueue::Admission::Result::rejected) return admission;
+	return _connection->admit(priority);
 }
 
-void Cunx::startListening()
+void Cunx::initCompleted()
 {
-	try
-	{
-		stopListening();
-		_socket = std::unique_ptr<BaseLib::TcpSocket>(new BaseLib::TcpSocket(_bl, _settings->host, _settings->port, _settings->ssl, _settings->caFile, _settings->verifyCertificate));
-		_socket->setAutoConnect(false);
-		_out.printDebug("Connecting to CUNX with hostname " + _settings->host + " on port " + _settings->port + "...");
-		_stopped = false;
-		if(_settings->listenThreadPriority > -1) GD::bl->threadManager.start(_listenThread, true, _settings->listenThreadPriority, _settings->listenThreadPolicy, &Cunx::listen, this);
-		else GD::bl->threadManager.start(_listenThread, true, &Cunx::listen, this);
-		IPhysicalInterface::startListening();
-	}
-    catch(const std::exception& ex)
-    {
-        _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    }
+	_ipAddress = _connection->getIpAddress();
+	_connection->initCompleted();
+}
+
+bool Cunx::sendCommand(const std::string& command)
+{
+	return _connection->sendCommand(_settings->stackPosition, command);
 }
 
-void Cunx::reconnect()
+void Cunx::startListening()
 {
 	try
 	{
-		_socket->close();
-		_out.printDebug("Connecting to CUNX device with hostname " + _settings->host + " on port " + _settings->port + "...");
-		_socket->open();
+		stopListening();
 		_hostname = _settings->host;
-		_ipAddress = _socket->getIpAddress();
+		resetStartupTime();
+		if(!_connection->addInterface(_settings->stackPosition, this)) return;
 		_stopped = false;
-		_out.printInfo("Connected to CUNX device with hostname " + _settings->host + " on port " + _settings->port + ".");
+		IPhysicalInterface::startListening();
+		_health->start();
 	}
     catch(const std::exception& ex)
     {
@@ -160,11 +129,10 @@ void Cunx::stopListening()
 {
 	try
 	{
-		_stopCallbackThread = true;
-		GD::bl->threadManager.join(_listenThread);
-		_stopCallbackThread = false;
-		_socket->close();
+		if(_stopped) return;
+		_connection->removeInterface(_settings->stackPosition);
 		_stopped = true;
+		_health->stop();
 		IPhysicalInterface::stopListening();
 	}
 	catch(const std::exception& ex)
@@ -173,115 +141,30 @@ void Cunx::stopListening()
     }
 }
 
-void Cunx::listen()
-{
-    try
-    {
-    	uint32_t receivedBytes = 0;
-    	int32_t bufferMax = 2048;
-		std::vector<char> buffer(bufferMax);
-
-        while(!_stopCallbackThread)
-        {
-        	if(_stopped || !_socket->connected())
-        	{
-        		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        		if(_stopCallbackThread) return;
-        		if(_stopped) _out.printWarning("Warning: Connection to CUNX closed. Trying to reconnect...");
-        		reconnect();
-        		continue;
-        	}
-        	std::vector<uint8_t> data;
-			try
-			{
-				do
-				{
-					receivedBytes = _socket->proofread(&buffer[0], bufferMax);
-					if(receivedBytes > 0)
-					{
-						data.insert(data.end(), &buffer.at(0), &buffer.at(0) + receivedBytes);
-						if(data.size() > 1000000)
-						{
-							_out.printError("Could not read from CUNX: Too much data.");
-							break;
-						}
-					}
-				} while(receivedBytes == (unsigned)bufferMax);
-			}
-			catch(const BaseLib::SocketTimeOutException& ex)
-			{
-				if(data.empty()) continue; //When receivedBytes is exactly 2048 bytes long, proofread will be called again, time out and the packet is received with a delay of 5 seconds. It doesn't matter as packets this big are only received at start up.
-			}
-			catch(const BaseLib::SocketClosedException& ex)
-			{
-				_stopped = true;
-				_out.printWarning("Warning: " + std::string(ex.what()));
-				std::this_thread::sleep_for(std::chrono::milliseconds(10000));
-				continue;
-			}
-			catch(const BaseLib::SocketOperationException& ex)
-			{
-				_stopped = true;
-				_out.printError("Error: " + std::string(ex.what()));
-				std::this_thread::sleep_for(std::chrono::milliseconds(10000));
-				continue;
-			}
-			if(data.empty() || data.size() > 1000000) continue;
-
-        	if(_bl->debugLevel >= 6)
-        	{
-        		_out.printDebug("Debug: Packet received from CUNX. Raw data: " + BaseLib::HelperFunctions::getHexString(data));
-        	}
-
-        	processData(data);
-
-        	_lastPacketReceived = BaseLib::HelperFunctions::getTime();
-        }
-    }
-    catch(const std::exception& ex)
-    {
-        _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    }
-}
-
-void Cunx::processData(std::vector<uint8_t>& data)
+void Cunx::processPacket(std::string& packet)
 {
 	try
 	{
-		if(data.empty()) return;
-		std::string packets;
-		packets.insert(packets.end(), data.begin(), data.end());
-
-		if(GD::bl->debugLevel >= 5) _out.printDebug("Debug: Raw packet received: " + BaseLib::HelperFunctions::trim(packets));
+		Logging::debug(_out, [&]() { return "Debug: Raw packet received: " + packet; });
+		if(processResponse(packet) || processFrame(packet)) return;
 
-		std::istringstream stringStream(packets);
-		std::string packetHex;
-		while(std::getline(stringStream, packetHex))
+	    // CULTX
+	    /*if(packetHex.size() > 9 && packetHex.at(0) == 't' && (packetHex.at(5) == packetHex.at(8) || packetHex.at(6) == packetHex.at(9)))
 		{
-		    if (stackPrefix.empty()) {
-		      if(packetHex.size() > 0 && packetHex.at(0) == '*') return;
-		    } else {
-		      if (packetHex.size() + 1 <= stackPrefix.size()) return;
-		      if (packetHex.substr(0, stackPrefix.size()) != stackPrefix || packetHex.at(stackPrefix.size()) == '*') return;
-		      else packetHex = packetHex.substr(stackPrefix.size());
-		    }
-
-		    // CULTX
-		    /*if(packetHex.size() > 9 && packetHex.at(0) == 't' && (packetHex.at(5) == packetHex.at(8) || packetHex.at(6) == packetHex.at(9)))
-			{
-		    	if(GD::bl->debugLevel >= 5) _out.printDebug("Debug: Recognized CULTX packet");
-		    	PMyCulTxPacket packet = std::make_shared<MyCulTxPacket>(packetHex);
-		    	packet->setTag(GD::CULTX);
-				raisePacketReceived(packet);
-				continue;
-			}*/
-
-		    // Not recognized
-			if(packetHex == "LOVF\n") _out.printWarning("Warning: CUNX with id " + _settings->id + " reached 1% limit. You need to wait, before sending is allowed again.");
-			else _out.printInfo("Info: Unknown Somfy packet received: " + packetHex);
+	    	if(GD::bl->debugLevel >= 5) _out.printDebug("Debug: Recognized CULTX packet");
+	    	PMyCulTxPacket packet = std::make_shared<MyCulTxPacket>(packetHex);
+	    	packet->setTag(GD::CULTX);
+			raisePacketReceived(packet);
 			continue;
+		}*/
 
+	    // Not recognized
+		if(packet == "LOVF")
+		{
+			_connection->budgetExhausted();
+			Logging::warning(_out, _lovfLogLimiter, [&]() { return "Warning: CUNX with id " + _settings->id + " reached 1% limit. You need to wait, before sending is allowed again."; });
 		}
+		else Logging::info(_out, [&]() { return "Info: Unknown Somfy packet received: " + packet; });
 	}
     catch(const std::exception& ex)
     {
@@ -33,6 +33,8 @@
 
 #include <homegear-base/BaseLib.h>
 #include "ISomfyInterface.h"
+#include "CunxConnection.h"
+#include "../Logging.h"
 
 namespace MyFamily
 {
@@ -44,20 +46,21 @@ class Cunx : public ISomfyInterface
         virtual ~Cunx();
         void startListening();
         void stopListening();
-        virtual bool isOpen() { return _socket->connected(); }
+        virtual bool isOpen() { return !_stopped && _connection->isOpen(); }
 		
 		void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet);
+        virtual TransmitQueue::Statistics getTransmitStatistics() { return _connection->getTransmitStatistics(); }
+        virtual TransmitQueue::Admission admit(TransmitPriority priority);
+        virtual TransmitQueue::DrainResult drain(int64_t deadline) { return _connection->drain(deadline); }
     protected:
-        BaseLib::Output _out;
-        std::string _port;
-        std::unique_ptr<BaseLib::TcpSocket> _socket;
-        std::string stackPrefix;
+        //Shared by all interfaces stacked on the same CUNX host
+        std::shared_ptr<CunxConnection> _connection;
+        LogRateLimiter _lovfLogLimiter;
+        LogRateLimiter _queueingLogLimiter;
 
-        void reconnect();
-        void processData(std::vector<uint8_t>& data);
-        void send(std::string data);
-        std::string readFromDevice();
-        void listen();
+        virtual void processPacket(std::string& packet);
+        virtual bool sendCommand(const std::string& command);
+        virtual void initCompleted();
     private:
 };
 
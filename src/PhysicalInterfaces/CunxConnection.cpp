@@ -0,0 +1,341 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "CunxConnection.h"
+#include "ISomfyInterface.h"
+#include "../GD.h"
+
+#include <sys/epoll.h>
+
+namespace MyFamily
+{
+
+std::mutex CunxConnection::_connectionsMutex;
+std::map<std::string, std::weak_ptr<CunxConnection>> CunxConnection::_connections;
+
+std::shared_ptr<CunxConnection> CunxConnection::get(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings)
+{
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	std::string key = settings->host + ":" + settings->port;
+	std::shared_ptr<CunxConnection> connection = _connections[key].lock();
+	if(!connection)
+	{
+		connection.reset(new CunxConnection(settings));
+		_connections[key] = connection;
+	}
+	else if(connection->_settings->ssl != settings->ssl) GD::out.printWarning("Warning: Interfaces using CUNX host " + key + " have different SSL settings. Using the settings of interface \"" + connection->_settings->id + "\".");
+	return connection;
+}
+
+CunxConnection::CunxConnection(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : _transmitQueue(_out, [this](const TransmitQueue::Frame& frame) { return writeFrame(frame); }, [this](int32_t timeout) { GD::reactor->setTimer(this, timeout); })
+{
+	_settings = settings;
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "CUNX " + settings->host + ":" + settings->port + ": ");
+
+	signal(SIGPIPE, SIG_IGN);
+
+	//Created once and only reopened, so the pointer never changes while other threads use it.
+	_socket = std::unique_ptr<BaseLib::TcpSocket>(new BaseLib::TcpSocket(GD::bl, _settings->host, _settings->port, _settings->ssl, _settings->caFile, _settings->verifyCertificate));
+	_socket->setAutoConnect(false);
+	//Reads are only done when epoll reported data, so they must not wait long for more.
+	_socket->setReadTimeout(100000);
+}
+
+CunxConnection::~CunxConnection()
+{
+	try
+	{
+		stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool CunxConnection::addInterface(uint32_t stackPosition, ISomfyInterface* interface)
+{
+	try
+	{
+		std::lock_guard<std::mutex> listenGuard(_listenMutex);
+		if(!_demultiplexer.addInterface(stackPosition, interface))
+		{
+			_out.printError("Error: Stack position " + std::to_string(stackPosition) + " is used by more than one interface.");
+			return false;
+		}
+		if(_demultiplexer.interfaceCount() == 1) startListening();
+		else if(isOpen()) writeFrame(interface->startInit(StackDemultiplexer::getStackPrefix(stackPosition)));
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void CunxConnection::removeInterface(uint32_t stackPosition)
+{
+	try
+	{
+		std::lock_guard<std::mutex> listenGuard(_listenMutex);
+		if(_demultiplexer.removeInterface(stackPosition) == 0) stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+std::string CunxConnection::getIpAddress()
+{
+	std::lock_guard<std::mutex> sendGuard(_sendMutex);
+	return _ipAddress;
+}
+
+bool CunxConnection::send(uint32_t stackPosition, const std::string& data, std::shared_ptr<MyPacket> packet)
+{
+	if(data.size() < 3) return false;
+	//Frames are held back while the devices are initialized.
+	return _transmitQueue.send(data, stackPosition, isOpen() && _demultiplexer.initDone(), packet);
+}
+
+bool CunxConnection::writeFrame(const std::string& data)
+{
+	try
+	{
+		//Returns before locking, so callers on the reactor thread are not blocked while the connect thread connects.
+		if(_stopped) return false;
+		std::lock_guard<std::mutex> sendGuard(_sendMutex);
+		if(_stopped || !_socket->connected()) return false;
+		_socket->proofwrite(data);
+		return true;
+	}
+	catch(const BaseLib::SocketOperationException& ex)
+	{
+		_out.printError(ex.what());
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_stopped = true;
+	if(_listening) GD::reactor->setTimer(this, 1000);
+	return false;
+}
+
+bool CunxConnection::writeFrame(const TransmitQueue::Frame& frame)
+{
+	std::string data = StackDemultiplexer::getStackPrefix(frame.stackPosition) + frame.data;
+	if(!writeFrame(data)) return false;
+	_demultiplexer.frameWritten(frame.stackPosition, data, frame.packet);
+	return true;
+}
+
+void CunxConnection::startListening()
+{
+	try
+	{
+		_listening = true;
+		_stopped = true;
+		_demultiplexer.reset();
+		GD::reactor->addHandler(this);
+		GD::reactor->setTimer(this, 0);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CunxConnection::stopListening()
+{
+	try
+	{
+		_listening = false;
+		//No timers run after this, so no new connect thread is started. A running one can't add the socket anymore.
+		GD::reactor->removeHandler(this);
+		{
+			std::lock_guard<std::mutex> connectThreadGuard(_connectThreadMutex);
+			GD::bl->threadManager.join(_connectThread);
+		}
+		closeSocket();
+		_transmitQueue.clear();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CunxConnection::closeSocket()
+{
+	GD::reactor->removeDescriptor(_socketDescriptor);
+	std::lock_guard<std::mutex> sendGuard(_sendMutex);
+	_socketDescriptor = -1;
+	_socket->close();
+	_stopped = true;
+}
+
+void CunxConnection::reconnect()
+{
+	try
+	{
+		if(!_listening)
+		{
+			_connecting = false;
+			return;
+		}
+		GD::reactor->removeDescriptor(_socketDescriptor);
+		int32_t descriptor = -1;
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_socket->close();
+		}
+		//Opening blocks up to the socket's timeout. _sendMutex is not held, _stopped keeps writers away from the socket.
+		_out.printDebug("Connecting to CUNX device with hostname " + _settings->host + " on port " + _settings->port + "...");
+		_socket->open();
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			BaseLib::PFileDescriptor fileDescriptor = _socket->getFileDescriptor();
+			if(fileDescriptor) descriptor = fileDescriptor->descriptor;
+			_ipAddress = _socket->getIpAddress();
+		}
+		_demultiplexer.reset();
+		//Set before the reactor watches the descriptor, so descriptorEvent() doesn't ignore the first data.
+		_socketDescriptor = descriptor;
+		if(!_listening || !GD::reactor->addDescriptor(descriptor, EPOLLIN, this))
+		{
+			std::lock_guard<std::mutex> sendGuard(_sendMutex);
+			_socketDescriptor = -1;
+			_socket->close();
+		}
+		else
+		{
+			_stopped = false;
+			_out.printInfo("Connected to CUNX device with hostname " + _settings->host + " on port " + _settings->port + ".");
+			//The commands of all stacked devices are written at once, the answers are matched as they arrive.
+			writeFrame(_demultiplexer.startInit());
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_connecting = false;
+	//Either retries or sends the queued frames once the devices are initialized.
+	if(_listening) GD::reactor->setTimer(this, _stopped ? 1000 : _demultiplexer.initTimeLeft());
+}
+
+void CunxConnection::initCompleted()
+{
+	//Sends the frames held back on the reactor thread.
+	GD::reactor->setTimer(this, 0);
+}
+
+void CunxConnection::timerExpired()
+{
+	try
+	{
+		if(!_listening || _connecting) return;
+		if(!_stopped)
+		{
+			if(!_demultiplexer.initDone()) GD::reactor->setTimer(this, _demultiplexer.initTimeLeft());
+			else _transmitQueue.flush();
+			return;
+		}
+		std::lock_guard<std::mutex> connectThreadGuard(_connectThreadMutex);
+		if(!_listening) return;
+		GD::bl->threadManager.join(_connectThread);
+		_connecting = true;
+		GD::bl->threadManager.start(_connectThread, false, &CunxConnection::reconnect, this);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void CunxConnection::descriptorEvent(int32_t descriptor, uint32_t events)
+{
+	try
+	{
+		if(descriptor != _socketDescriptor) return;
+		int32_t reconnectDelay = 0;
+		try
+		{
+			if(events & (EPOLLERR | EPOLLHUP)) throw BaseLib::SocketClosedException("Connection closed by CUNX.");
+			int32_t bufferMax = 2048;
+			std::vector<char> buffer(bufferMax);
+			int32_t receivedBytes = 0;
+			//With TLS, data already decrypted into the socket's buffer doesn't trigger another EPOLLIN, so it is read until a read returns less than the buffer size.
+			do
+			{
+				receivedBytes = _socket->proofread(&buffer[0], bufferMax);
+				if(receivedBytes > 0)
+				{
+					Logging::debug(_out, [&]() { return "Debug: Data received from CUNX. Raw data: " + BaseLib::HelperFunctions::getHexString((uint8_t*)buffer.data(), receivedBytes); }, 6);
+
+					//Recorded before it is split into lines, so a capture replays through the same demultiplexing. Lines split
+					//across reads are kept by the demultiplexer until the line end arrives.
+					_demultiplexer.recordReceived(buffer.data(), receivedBytes);
+					_demultiplexer.processData(buffer.data(), receivedBytes);
+				}
+			} while(receivedBytes == bufferMax);
+		}
+		catch(const BaseLib::SocketTimeOutException& ex)
+		{
+		}
+		catch(const BaseLib::SocketClosedException& ex)
+		{
+			_out.printWarning("Warning: " + std::string(ex.what()));
+			reconnectDelay = 10000;
+		}
+		catch(const BaseLib::SocketOperationException& ex)
+		{
+			_out.printError("Error: " + std::string(ex.what()));
+			reconnectDelay = 10000;
+		}
+		//While the connect thread is still initializing the new connection, _stopped is true but the socket is fine.
+		if(reconnectDelay == 0 && (!_stopped || _connecting)) return;
+
+		_out.printWarning("Warning: Connection to CUNX closed. Trying to reconnect...");
+		closeSocket();
+		GD::reactor->setTimer(this, reconnectDelay == 0 ? 1000 : reconnectDelay);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
@@ -0,0 +1,200 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "HealthMonitor.h"
+#include "../GD.h"
+
+#include <cmath>
+
+namespace MyFamily
+{
+
+HealthMonitor::HealthMonitor(BaseLib::Output& out, ProbeSender sender) : _out(out), _sender(sender)
+{
+}
+
+HealthMonitor::~HealthMonitor()
+{
+	try
+	{
+		stop();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void HealthMonitor::start()
+{
+	try
+	{
+		if(GD::probeInterval <= 0 || _started) return;
+		{
+			std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+			_probeTime = 0;
+			_consecutiveTimeouts = 0;
+			_statistics.state = State::unknown;
+		}
+		_state = State::unknown;
+		_started = true;
+		GD::reactor->addHandler(this);
+		//Give the device some time to process its initialization first.
+		GD::reactor->setTimer(this, 5000);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void HealthMonitor::stop()
+{
+	if(!_started) return;
+	_started = false;
+	if(GD::reactor) GD::reactor->removeHandler(this);
+	std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+	_probeTime = 0;
+	_statistics.state = State::unknown;
+	_state = State::unknown;
+}
+
+bool HealthMonitor::responseReceived()
+{
+	try
+	{
+		{
+			std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+			if(_probeTime == 0) return false;
+			int64_t time = BaseLib::HelperFunctions::getTime();
+			double roundTripTime = time - _probeTime;
+			_probeTime = 0;
+			if(_statistics.lastResponse == 0)
+			{
+				_statistics.latency = roundTripTime;
+				_statistics.jitter = roundTripTime / 2;
+			}
+			else
+			{
+				_statistics.jitter += (std::fabs(_statistics.latency - roundTripTime) - _statistics.jitter) / 4;
+				_statistics.latency += (roundTripTime - _statistics.latency) / 8;
+			}
+			_statistics.lastResponse = time;
+			_consecutiveTimeouts = 0;
+			updateState();
+		}
+		GD::reactor->setTimer(this, GD::probeInterval);
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+HealthMonitor::Statistics HealthMonitor::getStatistics()
+{
+	std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+	return _statistics;
+}
+
+std::string HealthMonitor::getStateName(State state)
+{
+	switch(state)
+	{
+	case State::healthy:
+		return "healthy";
+	case State::degraded:
+		return "degraded";
+	case State::failed:
+		return "failed";
+	default:
+		return "unknown";
+	}
+}
+
+void HealthMonitor::updateState()
+{
+	//_statisticsMutex must be locked
+	State state = State::healthy;
+	if(_consecutiveTimeouts >= failedAfterTimeouts) state = State::failed;
+	else if(_consecutiveTimeouts > 0 || (GD::degradedLatency > 0 && _statistics.latency > GD::degradedLatency)) state = State::degraded;
+	else if(_statistics.lastResponse == 0) state = State::unknown;
+	if(state == _statistics.state) return;
+
+	std::string message = "Device is " + getStateName(state) + " (latency " + std::to_string((int64_t)_statistics.latency) + " ms, " + std::to_string(_consecutiveTimeouts) + " unanswered probes).";
+	if(state == State::healthy) _out.printInfo("Info: " + message);
+	else _out.printWarning("Warning: " + message);
+	_statistics.state = state;
+	_state = state;
+}
+
+void HealthMonitor::timerExpired()
+{
+	try
+	{
+		if(!_started) return;
+		{
+			std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+			if(_probeTime != 0)
+			{
+				//The probe wasn't answered in time.
+				_probeTime = 0;
+				_statistics.timeouts++;
+				_consecutiveTimeouts++;
+				updateState();
+				int32_t delay = GD::probeInterval - GD::probeTimeout;
+				GD::reactor->setTimer(this, delay > 0 ? delay : 0);
+				return;
+			}
+			_probeTime = BaseLib::HelperFunctions::getTime();
+			_statistics.probes++;
+		}
+
+		if(!_sender("V\n"))
+		{
+			//The link is down. That is reported by the interface itself, so it doesn't count as an unanswered probe.
+			std::lock_guard<std::mutex> statisticsGuard(_statisticsMutex);
+			_probeTime = 0;
+			_statistics.probes--;
+			GD::reactor->setTimer(this, GD::probeInterval);
+			return;
+		}
+		GD::reactor->setTimer(this, GD::probeTimeout);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
@@ -0,0 +1,108 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef HEALTHMONITOR_H_
+#define HEALTHMONITOR_H_
+
+#include <homegear-base/BaseLib.h>
+#include "Reactor.h"
+
+namespace MyFamily
+{
+
+/**
+ * RTS devices never answer, so a stick that stopped working is otherwise only noticed when blinds don't move. While the
+ * link is up, the monitor periodically sends culfw's version query "V" and measures the time until the answer. The
+ * round-trip time and its variation are smoothed like TCP's SRTT and RTTVAR. One unanswered probe or a high latency
+ * marks the interface degraded, three unanswered probes in a row mark it failed.
+ */
+class HealthMonitor : public Reactor::IEventHandler
+{
+public:
+	enum class State : int32_t
+	{
+		unknown = 0, //Not started or no probe answered yet
+		healthy = 1,
+		degraded = 2,
+		failed = 3
+	};
+
+	struct Statistics
+	{
+		State state = State::unknown;
+		double latency = 0; //Milliseconds
+		double jitter = 0; //Milliseconds
+		uint64_t probes = 0;
+		uint64_t timeouts = 0;
+		int64_t lastResponse = 0;
+	};
+
+	/**
+	 * Writes the probe to the device bypassing the transmit queue. Returns false if the link is down.
+	 */
+	typedef std::function<bool(const std::string& command)> ProbeSender;
+
+	HealthMonitor(BaseLib::Output& out, ProbeSender sender);
+	virtual ~HealthMonitor();
+
+	void start();
+	void stop();
+
+	/**
+	 * Called for every version line ("V ...") received. Returns false if no probe was waiting for an answer, i. e. the
+	 * line answers a query sent by someone else.
+	 */
+	bool responseReceived();
+
+	State getState() { return _state; }
+	Statistics getStatistics();
+	static std::string getStateName(State state);
+private:
+	static const uint32_t failedAfterTimeouts = 3;
+
+	BaseLib::Output& _out;
+	ProbeSender _sender;
+	std::atomic_bool _started{false};
+	std::atomic<State> _state{State::unknown};
+
+	std::mutex _statisticsMutex;
+	Statistics _statistics;
+	int64_t _probeTime = 0; //Time the unanswered probe was sent, 0 if none is waiting
+	uint32_t _consecutiveTimeouts = 0;
+
+	void updateState();
+	virtual void timerExpired();
+	virtual void descriptorEvent(int32_t descriptor, uint32_t events) {}
+};
+
+}
+
+#endif
@@ -31,6 +31,7 @@
 #include "../GD.h"
 #include "../MyPacket.h"
 #include "ISomfyInterface.h"
+#include "../Logging.h"
 
 namespace MyFamily
 {
@@ -38,17 +39,318 @@ namespace MyFamily
 ISomfyInterface::ISomfyInterface(std::shared_ptr<BaseLib::Systems::PhysicalInterfaceSettings> settings) : IPhysicalInterface(GD::bl, GD::family->getFamily(), settings)
 {
 	_bl = GD::bl;
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "Interface \"" + settings->id + "\": ");
 
 	if(settings->listenThreadPriority == -1)
 	{
 		settings->listenThreadPriority = 0;
 		settings->listenThreadPolicy = SCHED_OTHER;
 	}
+
+	_health.reset(new HealthMonitor(_out, [this](const std::string& command) { return sendCommand(command); }));
+	_replayDemultiplexer.addInterface(settings->stackPosition, this);
 }
 
 ISomfyInterface::~ISomfyInterface()
 {
+	_health->stop();
+	stopRecording();
+}
+
+void ISomfyInterface::processData(std::vector<uint8_t>& data)
+{
+	try
+	{
+		//Captures of stacked devices hold the data of the whole stack, so it is demultiplexed as on the connection.
+		_replayDemultiplexer.processData((char*)data.data(), data.size());
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ISomfyInterface::receivePacket(std::string& packet)
+{
+	try
+	{
+		_lastPacketReceived = BaseLib::HelperFunctions::getTime();
+		processPacket(packet);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void ISomfyInterface::frameWritten(const std::string& data, const std::shared_ptr<MyPacket>& packet)
+{
+	try
+	{
+		if(packet) Logging::info(_out, [&]() { return "Info: Sending (" + _settings->id + "): " + packet->culHexString(); });
+		record(TrafficRecorder::Direction::sent, data.data(), data.size());
+		_lastPacketSent = BaseLib::HelperFunctions::getTime();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+TransmitQueue::Admission ISomfyInterface::admit(TransmitPriority priority)
+{
+	TransmitQueue::Admission admission;
+	if(GD::shuttingDown)
+	{
+		admission.result = TransmitQueue::Admission::Result::rejected;
+		admission.reason = "Homegear is shutting down.";
+	}
+	else if(_stopped)
+	{
+		admission.result = TransmitQueue::Admission::Result::rejected;
+		admission.linkDown = true;
+		admission.reason = "Interface is not started.";
+	}
+	else if(_health->getState() == HealthMonitor::State::failed)
+	{
+		//Connected, but frames would go to a device that doesn't process them.
+		admission.result = TransmitQueue::Admission::Result::rejected;
+		admission.linkDown = true;
+		admission.reason = "Device doesn't answer.";
+	}
+	else if(!getFirmwareInfo().rts)
+	{
+		admission.result = TransmitQueue::Admission::Result::rejected;
+		admission.reason = "The firmware of the device doesn't support Somfy RTS.";
+	}
+	return admission;
+}
+
+bool ISomfyInterface::processResponse(const std::string& packet)
+{
+	try
+	{
+		if(packet.size() < 2 || packet[1] != ' ') return false;
+		if(packet[0] == 'V')
+		{
+			bool completed = false;
+			{
+				std::lock_guard<std::mutex> initGuard(_initMutex);
+				if(_initPending & InitQuery::versionQuery)
+				{
+					//E. g. "V 1.67 CUL868"
+					std::vector<std::string> fields = BaseLib::HelperFunctions::splitAll(packet.substr(2), ' ');
+					_firmwareInfo.version = fields.at(0);
+					_firmwareInfo.board = fields.size() > 1 ? fields.at(1) : "";
+					_initPending &= ~InitQuery::versionQuery;
+					completed = _initPending == 0;
+					if(completed) initFinished();
+					_out.printInfo("Info: Firmware version: " + packet.substr(2));
+				}
+				else if(_health->responseReceived()) Logging::debug(_out, [&]() { return "Debug: Probe answered: " + packet; }, 5);
+				else Logging::info(_out, [&]() { return "Info: Firmware version: " + packet.substr(2); });
+			}
+			if(completed) initCompleted();
+			return true;
+		}
+		else if(packet[0] == '?')
+		{
+			//Unknown commands are answered with the list of known ones: "? (? is unknown) Use one of A B b C F ..."
+			std::string::size_type listStart = packet.find("Use one of");
+			if(listStart == std::string::npos) return false;
+			bool completed = false;
+			{
+				std::lock_guard<std::mutex> initGuard(_initMutex);
+				if(!(_initPending & InitQuery::commandQuery)) return true;
+				_firmwareInfo.commands = packet.substr(listStart + 10);
+				BaseLib::HelperFunctions::trim(_firmwareInfo.commands);
+				_firmwareInfo.rts = (" " + _firmwareInfo.commands + " ").find(" Y ") != std::string::npos;
+				if(!_firmwareInfo.rts) _out.printError("Error: The firmware of the device doesn't support Somfy RTS. Please install a culfw version with the \"Y\" command.");
+				_initPending &= ~InitQuery::commandQuery;
+				completed = _initPending == 0;
+				if(completed) initFinished();
+			}
+			if(completed) initCompleted();
+			return true;
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+bool ISomfyInterface::processFrame(const std::string& packet)
+{
+	try
+	{
+		if(packet.size() < 2 || packet.compare(0, 2, "Ys") != 0) return false;
+		PMyPacket frame = MyPacket::fromReceivedFrame(packet);
+		if(!frame)
+		{
+			Logging::debug(_out, [&]() { return "Debug: Invalid RTS frame received: " + packet; });
+			return true;
+		}
+		Logging::info(_out, [&]() { return "Info: RTS frame received from 0x" + BaseLib::HelperFunctions::getHexString(frame->senderAddress(), 6) + " (RSSI: " + std::to_string(frame->getRssi()) + " dBm): Command 0x" + BaseLib::HelperFunctions::getHexString((int32_t)frame->getControlCode(), 1) + ", rolling code " + std::to_string(frame->getRollingCode()); });
+		raisePacketReceived(frame);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return true;
+}
+
+std::string ISomfyInterface::startInit(const std::string& stackPrefix)
+{
+	{
+		std::lock_guard<std::mutex> initGuard(_initMutex);
+		_initPending = InitQuery::versionQuery | InitQuery::commandQuery;
+		_initDeadline = BaseLib::HelperFunctions::getTime() + initTimeout;
+	}
+	std::string sequence = stackPrefix + "V\n" + stackPrefix + "?\n" + stackPrefix + "X21\n";
+	if(_settings->additionalCommands.empty()) return sequence;
+	std::vector<std::string> additionalCommands = BaseLib::HelperFunctions::splitAll(_settings->additionalCommands, ',');
+	for(auto& command : additionalCommands)
+	{
+		BaseLib::HelperFunctions::trim(command);
+		if(!command.empty()) sequence += stackPrefix + command + "\n";
+	}
+	return sequence;
+}
+
+bool ISomfyInterface::initDone()
+{
+	{
+		std::lock_guard<std::mutex> initGuard(_initMutex);
+		if(_initPending == 0) return true;
+		if(BaseLib::HelperFunctions::getTime() < _initDeadline) return false;
+		_out.printWarning("Warning: Device didn't answer the initialization commands in time. Sending queued packets anyway.");
+		_initPending = 0;
+		initFinished();
+	}
+	//Same as an answered initialization, so the frames held back are sent without waiting for the next send.
+	initCompleted();
+	return true;
+}
+
+void ISomfyInterface::resetStartupTime()
+{
+	_startupTime = -1;
+	_startTime = BaseLib::HelperFunctions::getTime();
+}
+
+void ISomfyInterface::initFinished()
+{
+	if(_startupTime != -1 || _startTime == 0) return;
+	_startupTime = BaseLib::HelperFunctions::getTime() - _startTime;
+	_out.printInfo("Info: Ready " + std::to_string(_startupTime) + " ms after start.");
+}
+
+int32_t ISomfyInterface::initTimeLeft()
+{
+	std::lock_guard<std::mutex> initGuard(_initMutex);
+	if(_initPending == 0) return 0;
+	int64_t timeLeft = _initDeadline - BaseLib::HelperFunctions::getTime();
+	return timeLeft > 0 ? (int32_t)timeLeft : 0;
+}
+
+ISomfyInterface::FirmwareInfo ISomfyInterface::getFirmwareInfo()
+{
+	std::lock_guard<std::mutex> initGuard(_initMutex);
+	return _firmwareInfo;
+}
+
+bool ISomfyInterface::startRecording(const std::string& filename)
+{
+	try
+	{
+		std::shared_ptr<TrafficRecorder> recorder = std::make_shared<TrafficRecorder>();
+		if(!recorder->open(filename))
+		{
+			_out.printError("Error: Could not open " + filename + " for recording.");
+			return false;
+		}
+		std::shared_ptr<TrafficRecorder> oldRecorder = std::atomic_exchange(&_recorder, recorder);
+		if(oldRecorder) oldRecorder->close();
+		_out.printInfo("Info: Recording traffic to " + filename + ".");
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
 
+void ISomfyInterface::stopRecording()
+{
+	try
+	{
+		std::shared_ptr<TrafficRecorder> recorder = std::atomic_exchange(&_recorder, std::shared_ptr<TrafficRecorder>());
+		if(!recorder) return;
+		recorder->close();
+		_out.printInfo("Info: Stopped recording after " + std::to_string(recorder->recordCount()) + " records.");
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool ISomfyInterface::replay(const std::string& filename, bool maxSpeed, ReplayStatistics& statistics, std::function<bool(std::chrono::steady_clock::time_point)> waitUntil)
+{
+	try
+	{
+		TrafficReader reader;
+		if(!reader.open(filename))
+		{
+			_out.printError("Error: " + filename + " is not a valid traffic capture.");
+			return false;
+		}
+
+		//A line left over from an earlier replay must not be joined with the first one of this capture.
+		_replayDemultiplexer.reset();
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		uint64_t captureTime = 0;
+		TrafficReader::Record record;
+		while(reader.next(record))
+		{
+			captureTime += record.delay;
+			if(record.direction == TrafficRecorder::Direction::sent)
+			{
+				statistics.sentRecords++;
+				continue;
+			}
+			if(!maxSpeed)
+			{
+				std::chrono::steady_clock::time_point time = startTime + std::chrono::microseconds(captureTime);
+				if(!waitUntil) std::this_thread::sleep_until(time);
+				else if(!waitUntil(time))
+				{
+					_out.printInfo("Info: Replay of " + filename + " stopped.");
+					return false;
+				}
+			}
+			statistics.receivedRecords++;
+			statistics.receivedBytes += record.data.size();
+			processData(record.data);
+		}
+		statistics.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+		if(reader.truncated())
+		{
+			_out.printError("Error: " + filename + " is truncated or damaged after " + std::to_string(statistics.receivedRecords + statistics.sentRecords) + " records.");
+			return false;
+		}
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
 }
 
 
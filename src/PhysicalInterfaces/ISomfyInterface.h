@@ -32,6 +32,10 @@
 #define ISOMFYINTERFACE_H_
 
 #include <homegear-base/BaseLib.h>
+#include "TrafficRecorder.h"
+#include "TransmitQueue.h"
+#include "HealthMonitor.h"
+#include "StackDemultiplexer.h"
 
 namespace MyFamily
 {
@@ -46,9 +50,183 @@ public:
 	virtual void stopListening() {}
 
 	virtual void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {}
+
+	/**
+	 * Returns the counters of the queue the interface sends through. Stacked interfaces share one queue.
+	 */
+	virtual TransmitQueue::Statistics getTransmitStatistics() { return TransmitQueue::Statistics(); }
+
+	/**
+	 * Predicts whether a packet sent now would be sent right away, queued or rejected. Called before the packet is built,
+	 * so a rejected command doesn't use up a rolling code.
+	 */
+	virtual TransmitQueue::Admission admit(TransmitPriority priority);
+
+	/**
+	 * Sends the queued packets until the deadline and drops the rest, see TransmitQueue::drain(). Stacked interfaces share
+	 * one queue, which is drained by the first call.
+	 */
+	virtual TransmitQueue::DrainResult drain(int64_t deadline) { return TransmitQueue::DrainResult(); }
+
+	// {{{ Initialization
+	/**
+	 * What the firmware reported during initialization.
+	 */
+	struct FirmwareInfo
+	{
+		std::string version; //E. g. "1.67"
+		std::string board; //E. g. "CUL868"
+		std::string commands; //The command letters the firmware knows
+		bool rts = true; //False if the firmware doesn't know "Y"
+	};
+
+	/**
+	 * Starts the initialization of the device and returns the commands to write at once without waiting for responses in
+	 * between: "V" and "?" to query the firmware version and its commands, "X21" to enable reporting of received packets
+	 * and of "LOVF", followed by "additionalCommands" from "somfy.conf". The answers are matched by processResponse().
+	 * Once both queries were answered or initTimeout passed, initCompleted() is called.
+	 *
+	 * @param stackPrefix Prepended to every command for stacked devices.
+	 */
+	std::string startInit(const std::string& stackPrefix = "");
+
+	/**
+	 * Returns true when the initialization is completed. Packets are held back until then. An initialization without
+	 * answer is given up here after initTimeout, so callers need no timer of their own.
+	 */
+	bool initDone();
+
+	/**
+	 * Returns the milliseconds until initDone() gives up waiting, 0 if the initialization is completed.
+	 */
+	int32_t initTimeLeft();
+
+	FirmwareInfo getFirmwareInfo();
+
+	/**
+	 * Returns the milliseconds from startListening() until the device was initialized the first time, -1 until then.
+	 */
+	int64_t getStartupTime() { return _startupTime; }
+	// }}}
+
+	HealthMonitor::State getHealthState() { return _health->getState(); }
+	HealthMonitor::Statistics getHealthStatistics() { return _health->getStatistics(); }
+
+	/**
+	 * Processes raw data as received from the device. By default the data is demultiplexed like the data of a stack of
+	 * devices: It is split into lines, lines split across calls are kept until their end arrives, and the lines for the
+	 * interface's stack position are passed to receivePacket(). Lines of other stack positions are ignored.
+	 */
+	virtual void processData(std::vector<uint8_t>& data);
+
+	/**
+	 * Called by StackDemultiplexer for every line addressed to this interface. The line has neither the stack prefix
+	 * nor a line end.
+	 */
+	void receivePacket(std::string& packet);
+
+	/**
+	 * Called by a connection shared by stacked devices with the data it received, before the data is split into lines.
+	 * The data is recorded as received.
+	 */
+	void dataReceived(const char* data, size_t size) { record(TrafficRecorder::Direction::received, data, size); }
+
+	/**
+	 * Called by a connection shared by stacked devices after it wrote a frame of this interface. The frame is logged,
+	 * recorded as sent and counts as the last packet sent.
+	 *
+	 * @param data The data written including the stack prefix.
+	 */
+	void frameWritten(const std::string& data, const std::shared_ptr<MyPacket>& packet);
+
+	// {{{ Record and replay
+	struct ReplayStatistics
+	{
+		uint64_t receivedRecords = 0;
+		uint64_t receivedBytes = 0;
+		uint64_t sentRecords = 0;
+		int64_t duration = 0; //Microseconds
+	};
+
+	bool startRecording(const std::string& filename);
+	void stopRecording();
+	bool isRecording() { return (bool)std::atomic_load(&_recorder); }
+
+	/**
+	 * Feeds the received data of a capture into processData().
+	 *
+	 * @param filename The file written by startRecording().
+	 * @param maxSpeed When true, the data is processed as fast as possible. Otherwise the original timing is kept.
+	 * @param statistics Filled with the number of records processed and the time it took.
+	 * @param waitUntil Used instead of sleeping when the original timing is kept. Returns false to stop the replay.
+	 * @return Returns false when the file could not be opened, is not a valid capture, is truncated or the replay was
+	 * stopped.
+	 */
+	bool replay(const std::string& filename, bool maxSpeed, ReplayStatistics& statistics, std::function<bool(std::chrono::steady_clock::time_point)> waitUntil = std::function<bool(std::chrono::steady_clock::time_point)>());
+	// }}}
 protected:
 	BaseLib::SharedObjects* _bl = nullptr;
 	BaseLib::Output _out;
+	std::shared_ptr<TrafficRecorder> _recorder;
+	std::unique_ptr<HealthMonitor> _health;
+	StackDemultiplexer _replayDemultiplexer; //Only holds this interface. Used by processData().
+
+	static const int32_t initTimeout = 3000;
+	enum InitQuery : uint32_t
+	{
+		versionQuery = 1,
+		commandQuery = 2
+	};
+	std::mutex _initMutex;
+	uint32_t _initPending = 0; //InitQuery flags of unanswered queries
+	int64_t _initDeadline = 0;
+	FirmwareInfo _firmwareInfo;
+	std::atomic<int64_t> _startTime{0};
+	std::atomic<int64_t> _startupTime{-1};
+
+	/**
+	 * Called at the beginning of startListening(). The time until the initialization completes is logged.
+	 */
+	void resetStartupTime();
+
+	/**
+	 * Called with _initMutex locked when the initialization completed or was given up.
+	 */
+	void initFinished();
+
+	/**
+	 * Writes a culfw command (e. g. "V\n") to the device right away, bypassing the transmit queue. Returns false if the
+	 * device is not connected.
+	 */
+	virtual bool sendCommand(const std::string& command) { return false; }
+
+	/**
+	 * Handles answers to commands sent by the module itself. Returns true if the line was one of them.
+	 */
+	bool processResponse(const std::string& packet);
+
+	/**
+	 * Decodes RTS frames received by the device (e. g. sent by a remote or by another interface) and passes them to the
+	 * central. Returns true if the line was a frame, including invalid ones.
+	 */
+	bool processFrame(const std::string& packet);
+
+	/**
+	 * Called on the thread processing received data when the initialization is completed. Should trigger sending the
+	 * packets held back.
+	 */
+	virtual void initCompleted() {}
+
+	/**
+	 * Processes one line received from the device without line end.
+	 */
+	virtual void processPacket(std::string& packet) {}
+
+	void record(TrafficRecorder::Direction direction, const char* data, size_t size)
+	{
+		std::shared_ptr<TrafficRecorder> recorder = std::atomic_load(&_recorder);
+		if(recorder) recorder->record(direction, data, size);
+	}
 };
 
 }
@@ -0,0 +1,94 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef LINEBUFFER_H_
+#define LINEBUFFER_H_
+
+#include <cstddef>
+#include <string>
+
+namespace MyFamily
+{
+
+/**
+ * Splits data arriving in chunks of any size into lines. The part of a line received so far is kept until its line end
+ * arrives with a later chunk. Lines end with "\n" or "\r\n". Not thread safe.
+ */
+class LineBuffer
+{
+public:
+	/**
+	 * @param maxLineLength Data without line end that grows beyond this is discarded, so garbage doesn't fill the
+	 * memory.
+	 */
+	explicit LineBuffer(size_t maxLineLength) : _maxLineLength(maxLineLength) {}
+
+	/**
+	 * Appends a chunk and calls "lineReceived" with every line completed by it. The line is passed without line end.
+	 *
+	 * @return Returns the number of bytes discarded, because they exceeded maxLineLength without line end.
+	 */
+	template<typename Callback> size_t append(const char* data, size_t size, Callback lineReceived)
+	{
+		_buffer.append(data, size);
+		size_t lineStart = 0;
+		size_t lineEnd = 0;
+		while((lineEnd = _buffer.find('\n', lineStart)) != std::string::npos)
+		{
+			size_t length = lineEnd - lineStart;
+			if(length > 0 && _buffer[lineEnd - 1] == '\r') length--;
+			lineReceived(_buffer.data() + lineStart, length);
+			lineStart = lineEnd + 1;
+		}
+		_buffer.erase(0, lineStart);
+		if(_buffer.size() <= _maxLineLength) return 0;
+		size_t discarded = _buffer.size();
+		_buffer.clear();
+		return discarded;
+	}
+
+	/**
+	 * Discards the partially received line, e. g. after a reconnect.
+	 */
+	void clear() { _buffer.clear(); }
+
+	/**
+	 * Returns the number of bytes of the partially received line.
+	 */
+	size_t size() const { return _buffer.size(); }
+private:
+	size_t _maxLineLength = 0;
+	std::string _buffer;
+};
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Reactor.h"
+#include "../GD.h"
+
+#include <array>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace MyFamily
+{
+
+Reactor::Reactor()
+{
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "Reactor: ");
+
+	_epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+	if(_epollDescriptor == -1) _out.printCritical("Critical: Could not create epoll instance: " + std::string(strerror(errno)));
+	_wakeUpDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(_wakeUpDescriptor == -1) _out.printCritical("Critical: Could not create event descriptor: " + std::string(strerror(errno)));
+	else if(_epollDescriptor != -1)
+	{
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = _wakeUpDescriptor;
+		epoll_ctl(_epollDescriptor, EPOLL_CTL_ADD, _wakeUpDescriptor, &event);
+	}
+}
+
+Reactor::~Reactor()
+{
+	try
+	{
+		stop();
+		if(_wakeUpDescriptor != -1) close(_wakeUpDescriptor);
+		if(_epollDescriptor != -1) close(_epollDescriptor);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Reactor::start(int32_t threadPriority, int32_t threadPolicy)
+{
+	try
+	{
+		stop();
+		_stopThread = false;
+		if(threadPriority > -1) GD::bl->threadManager.start(_thread, true, threadPriority, threadPolicy, &Reactor::run, this);
+		else GD::bl->threadManager.start(_thread, true, &Reactor::run, this);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void Reactor::stop()
+{
+	_stopThread = true;
+	wakeUp();
+	GD::bl->threadManager.join(_thread);
+}
+
+void Reactor::wakeUp()
+{
+	if(_wakeUpDescriptor == -1) return;
+	uint64_t value = 1;
+	if(write(_wakeUpDescriptor, &value, sizeof(value)) == -1) {} //Fails only if the counter overflows, in which case the thread wakes up anyway
+}
+
+void Reactor::addHandler(IEventHandler* handler)
+{
+	std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+	_handlers.insert(handler);
+}
+
+void Reactor::removeHandler(IEventHandler* handler)
+{
+	{
+		std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+		for(auto descriptorIterator = _descriptors.begin(); descriptorIterator != _descriptors.end();)
+		{
+			if(descriptorIterator->second == handler)
+			{
+				epoll_ctl(_epollDescriptor, EPOLL_CTL_DEL, descriptorIterator->first, nullptr);
+				descriptorIterator = _descriptors.erase(descriptorIterator);
+			}
+			else ++descriptorIterator;
+		}
+		_handlers.erase(handler);
+	}
+	cancelTimer(handler);
+}
+
+bool Reactor::addDescriptor(int32_t descriptor, uint32_t events, IEventHandler* handler)
+{
+	if(descriptor == -1) return false;
+	std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+	if(_handlers.find(handler) == _handlers.end()) return false;
+	epoll_event event{};
+	event.events = events;
+	event.data.fd = descriptor;
+	if(epoll_ctl(_epollDescriptor, EPOLL_CTL_ADD, descriptor, &event) == -1 && (errno != EEXIST || epoll_ctl(_epollDescriptor, EPOLL_CTL_MOD, descriptor, &event) == -1))
+	{
+		_out.printError("Error: Could not add descriptor " + std::to_string(descriptor) + ": " + std::string(strerror(errno)));
+		return false;
+	}
+	_descriptors[descriptor] = handler;
+	return true;
+}
+
+bool Reactor::modifyDescriptor(int32_t descriptor, uint32_t events)
+{
+	epoll_event event{};
+	event.events = events;
+	event.data.fd = descriptor;
+	return epoll_ctl(_epollDescriptor, EPOLL_CTL_MOD, descriptor, &event) == 0;
+}
+
+void Reactor::removeDescriptor(int32_t descriptor)
+{
+	if(descriptor == -1) return;
+	std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+	epoll_ctl(_epollDescriptor, EPOLL_CTL_DEL, descriptor, nullptr);
+	_descriptors.erase(descriptor);
+}
+
+void Reactor::setTimer(IEventHandler* handler, int32_t timeout)
+{
+	{
+		std::lock_guard<std::mutex> timersGuard(_timersMutex);
+		_timers[handler] = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	}
+	wakeUp();
+}
+
+void Reactor::cancelTimer(IEventHandler* handler)
+{
+	std::lock_guard<std::mutex> timersGuard(_timersMutex);
+	_timers.erase(handler);
+}
+
+int32_t Reactor::getTimeout()
+{
+	std::lock_guard<std::mutex> timersGuard(_timersMutex);
+	int64_t timeout = 1000;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	for(auto& timer : _timers)
+	{
+		int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(timer.second - now).count();
+		if(remaining < timeout) timeout = remaining < 0 ? 0 : remaining;
+	}
+	return timeout;
+}
+
+void Reactor::runTimers()
+{
+	std::vector<IEventHandler*> expired;
+	{
+		std::lock_guard<std::mutex> timersGuard(_timersMutex);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for(auto timerIterator = _timers.begin(); timerIterator != _timers.end();)
+		{
+			if(timerIterator->second <= now)
+			{
+				expired.push_back(timerIterator->first);
+				timerIterator = _timers.erase(timerIterator);
+			}
+			else ++timerIterator;
+		}
+	}
+	if(expired.empty()) return;
+
+	std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+	for(auto handler : expired)
+	{
+		try
+		{
+			if(_handlers.find(handler) != _handlers.end()) handler->timerExpired();
+		}
+		catch(const std::exception& ex)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
+void Reactor::run()
+{
+	try
+	{
+		std::array<epoll_event, 16> events;
+		while(!_stopThread)
+		{
+			int32_t eventCount = epoll_wait(_epollDescriptor, events.data(), events.size(), getTimeout());
+			if(_stopThread) return;
+			if(eventCount == -1)
+			{
+				if(errno == EINTR) continue;
+				_out.printError("Error: epoll_wait failed: " + std::string(strerror(errno)));
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+
+			for(int32_t i = 0; i < eventCount; i++)
+			{
+				int32_t descriptor = events[i].data.fd;
+				if(descriptor == _wakeUpDescriptor)
+				{
+					uint64_t value = 0;
+					if(read(_wakeUpDescriptor, &value, sizeof(value)) == -1) {}
+					continue;
+				}
+				try
+				{
+					std::lock_guard<std::recursive_mutex> handlersGuard(_handlersMutex);
+					auto descriptorIterator = _descriptors.find(descriptor);
+					//The descriptor might have been removed by a handler called before.
+					if(descriptorIterator == _descriptors.end()) continue;
+					descriptorIterator->second->descriptorEvent(descriptor, events[i].events);
+				}
+				catch(const std::exception& ex)
+				{
+					_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+				}
+			}
+
+			runTimers();
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+}
@@ -0,0 +1,119 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef REACTOR_H_
+#define REACTOR_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <set>
+#include <unordered_map>
+
+namespace MyFamily
+{
+
+/**
+ * One thread serving all physical interfaces. It waits for the sockets and serial ports of the interfaces with epoll
+ * and runs their timers (e. g. for reconnecting).
+ *
+ * Handlers are called with the reactor's handler mutex locked, so removeHandler() waits for running callbacks. Don't call
+ * addHandler(), removeHandler(), addDescriptor() or removeDescriptor() while holding a lock a callback also takes.
+ * modifyDescriptor(), setTimer() and cancelTimer() can be called from anywhere.
+ */
+class Reactor
+{
+public:
+	class IEventHandler
+	{
+	public:
+		virtual ~IEventHandler() = default;
+
+		/**
+		 * Called when a descriptor added with addDescriptor() is ready.
+		 *
+		 * @param descriptor The descriptor.
+		 * @param events The epoll events, e. g. EPOLLIN or EPOLLOUT. EPOLLERR and EPOLLHUP are always reported.
+		 */
+		virtual void descriptorEvent(int32_t descriptor, uint32_t events) = 0;
+
+		/**
+		 * Called when the timer set with setTimer() expires.
+		 */
+		virtual void timerExpired() = 0;
+	};
+
+	Reactor();
+	virtual ~Reactor();
+
+	void start(int32_t threadPriority, int32_t threadPolicy);
+	void stop();
+
+	void addHandler(IEventHandler* handler);
+
+	/**
+	 * Removes the handler with all of its descriptors and its timer. The handler isn't called anymore after this returns.
+	 */
+	void removeHandler(IEventHandler* handler);
+
+	bool addDescriptor(int32_t descriptor, uint32_t events, IEventHandler* handler);
+	bool modifyDescriptor(int32_t descriptor, uint32_t events);
+	void removeDescriptor(int32_t descriptor);
+
+	/**
+	 * Calls IEventHandler::timerExpired() after the timeout. Replaces a timer set before.
+	 *
+	 * @param timeout The timeout in milliseconds.
+	 */
+	void setTimer(IEventHandler* handler, int32_t timeout);
+	void cancelTimer(IEventHandler* handler);
+private:
+	BaseLib::Output _out;
+	int32_t _epollDescriptor = -1;
+	int32_t _wakeUpDescriptor = -1;
+	std::thread _thread;
+	std::atomic_bool _stopThread{false};
+
+	std::recursive_mutex _handlersMutex;
+	std::set<IEventHandler*> _handlers;
+	std::unordered_map<int32_t, IEventHandler*> _descriptors;
+
+	std::mutex _timersMutex;
+	std::unordered_map<IEventHandler*, std::chrono::steady_clock::time_point> _timers;
+
+	void wakeUp();
+	int32_t getTimeout();
+	void runTimers();
+	void run();
+};
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "StackDemultiplexer.h"
+#include "ISomfyInterface.h"
+#include "../GD.h"
+#include "../Logging.h"
+
+namespace MyFamily
+{
+
+std::string StackDemultiplexer::getStackPrefix(uint32_t stackPosition)
+{
+	if(stackPosition < 2) return "";
+	return std::string(stackPosition - 1, '*');
+}
+
+bool StackDemultiplexer::addInterface(uint32_t stackPosition, ISomfyInterface* interface)
+{
+	if(stackPosition == 0) stackPosition = 1;
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	std::lock_guard<std::mutex> frameWrittenGuard(_frameWrittenMutex);
+	return _interfaces.emplace(stackPosition, interface).second;
+}
+
+size_t StackDemultiplexer::removeInterface(uint32_t stackPosition)
+{
+	if(stackPosition == 0) stackPosition = 1;
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	std::lock_guard<std::mutex> frameWrittenGuard(_frameWrittenMutex);
+	_interfaces.erase(stackPosition);
+	return _interfaces.size();
+}
+
+size_t StackDemultiplexer::interfaceCount()
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	return _interfaces.size();
+}
+
+std::string StackDemultiplexer::startInit()
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	std::string sequence;
+	for(auto& interface : _interfaces)
+	{
+		sequence += interface.second->startInit(getStackPrefix(interface.first));
+	}
+	return sequence;
+}
+
+bool StackDemultiplexer::initDone()
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	bool done = true;
+	for(auto& interface : _interfaces)
+	{
+		//No early exit, so every interface gets the chance to give up waiting.
+		if(!interface.second->initDone()) done = false;
+	}
+	return done;
+}
+
+int32_t StackDemultiplexer::initTimeLeft()
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	int32_t timeLeft = 0;
+	for(auto& interface : _interfaces)
+	{
+		timeLeft = std::max(timeLeft, interface.second->initTimeLeft());
+	}
+	return timeLeft;
+}
+
+void StackDemultiplexer::reset()
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	_lineBuffer.clear();
+}
+
+void StackDemultiplexer::processData(const char* data, size_t size)
+{
+	try
+	{
+		//The mutex is held while dispatching, so removeInterface() waits for lines being processed by the interface.
+		std::lock_guard<std::mutex> interfacesGuard(_mutex);
+		size_t discarded = _lineBuffer.append(data, size, [this](const char* line, size_t length) { dispatch(line, length); });
+		if(discarded > 0) GD::out.printWarning("Warning: Discarding " + std::to_string(discarded) + " bytes without line end received from stacked device.");
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void StackDemultiplexer::recordReceived(const char* data, size_t size)
+{
+	std::lock_guard<std::mutex> interfacesGuard(_mutex);
+	for(auto& interface : _interfaces)
+	{
+		interface.second->dataReceived(data, size);
+	}
+}
+
+void StackDemultiplexer::frameWritten(uint32_t stackPosition, const std::string& data, const std::shared_ptr<MyPacket>& packet)
+{
+	if(stackPosition == 0) stackPosition = 1;
+	std::lock_guard<std::mutex> frameWrittenGuard(_frameWrittenMutex);
+	auto interfaceIterator = _interfaces.find(stackPosition);
+	if(interfaceIterator != _interfaces.end()) interfaceIterator->second->frameWritten(data, packet);
+}
+
+void StackDemultiplexer::dispatch(const char* line, size_t length)
+{
+	size_t prefixLength = 0;
+	while(prefixLength < length && line[prefixLength] == '*') prefixLength++;
+	if(prefixLength == length) return;
+
+	auto interfaceIterator = _interfaces.find(prefixLength + 1);
+	if(interfaceIterator == _interfaces.end())
+	{
+		Logging::debug(GD::out, [&]() { return "Debug: Ignoring line for stack position " + std::to_string(prefixLength + 1) + " without interface: " + std::string(line, length); });
+		return;
+	}
+	std::string packet(line + prefixLength, length - prefixLength);
+	interfaceIterator->second->receivePacket(packet);
+}
+
+}
@@ -0,0 +1,128 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef STACKDEMULTIPLEXER_H_
+#define STACKDEMULTIPLEXER_H_
+
+#include "LineBuffer.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace MyFamily
+{
+
+class ISomfyInterface;
+class MyPacket;
+
+/**
+ * Splits the data received from a stack of culfw devices (CUNX, SCC, ...) into lines and routes every line to the
+ * interface at the stack position given by its prefix. Stacked devices prefix their lines with one "*" per position
+ * above the first device.
+ */
+class StackDemultiplexer
+{
+public:
+	StackDemultiplexer() = default;
+	virtual ~StackDemultiplexer() = default;
+
+	/**
+	 * Returns the prefix of frames sent to or received from the device at the given stack position.
+	 */
+	static std::string getStackPrefix(uint32_t stackPosition);
+
+	/**
+	 * Registers an interface. Lines for the interface are passed to ISomfyInterface::receivePacket().
+	 *
+	 * @return Returns false if another interface already uses the stack position.
+	 */
+	bool addInterface(uint32_t stackPosition, ISomfyInterface* interface);
+
+	/**
+	 * Unregisters an interface. After this returns, the interface is not called anymore.
+	 *
+	 * @return Returns the number of interfaces still registered.
+	 */
+	size_t removeInterface(uint32_t stackPosition);
+
+	size_t interfaceCount();
+
+	/**
+	 * Starts the initialization of all registered interfaces and returns their init sequences with their stack prefixes,
+	 * so they can be written at once. The devices answer in parallel.
+	 */
+	std::string startInit();
+
+	/**
+	 * Returns true when all registered interfaces completed their initialization, see ISomfyInterface::initDone().
+	 */
+	bool initDone();
+
+	/**
+	 * Returns the longest time any registered interface still waits for its initialization to complete.
+	 */
+	int32_t initTimeLeft();
+
+	void processData(const char* data, size_t size);
+
+	/**
+	 * Passes data received by the connection to ISomfyInterface::dataReceived() of all registered interfaces before it
+	 * is split into lines, so their captures hold the data as received.
+	 */
+	void recordReceived(const char* data, size_t size);
+
+	/**
+	 * Passes a frame written to the device to ISomfyInterface::frameWritten() of the interface at the stack position.
+	 */
+	void frameWritten(uint32_t stackPosition, const std::string& data, const std::shared_ptr<MyPacket>& packet);
+
+	/**
+	 * Discards a partially received line, e. g. after a reconnect.
+	 */
+	void reset();
+private:
+	static const size_t maxLineLength = 1024;
+
+	std::mutex _mutex;
+	//Held by frameWritten() instead of _mutex, as frames are written with the transmit queue locked and dispatched
+	//lines may lock it. _interfaces is changed with both mutexes locked.
+	std::mutex _frameWrittenMutex;
+	std::map<uint32_t, ISomfyInterface*> _interfaces;
+	LineBuffer _lineBuffer{maxLineLength};
+
+	void dispatch(const char* line, size_t length);
+};
+
+}
+
+#endif
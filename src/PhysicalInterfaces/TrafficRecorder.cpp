@@ -0,0 +1,146 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TrafficRecorder.h"
+
+#include <algorithm>
+
+namespace MyFamily
+{
+
+static const char trafficFileMagic[4] = { 'H', 'G', 'S', 'R' };
+static const uint8_t trafficFileVersion = 1;
+static const uint64_t maxRecordSize = 1000000;
+
+static void writeVarint(std::ofstream& file, uint64_t value)
+{
+	char buffer[10];
+	size_t size = 0;
+	do
+	{
+		buffer[size] = (char)(value & 0x7F);
+		value >>= 7;
+		if(value) buffer[size] |= (char)0x80;
+		size++;
+	} while(value);
+	file.write(buffer, size);
+}
+
+TrafficRecorder::TrafficRecorder()
+{
+}
+
+TrafficRecorder::~TrafficRecorder()
+{
+	close();
+}
+
+bool TrafficRecorder::open(const std::string& filename)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(_file.is_open()) _file.close();
+	_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!_file.is_open()) return false;
+	_file.write(trafficFileMagic, sizeof(trafficFileMagic));
+	_file.put((char)trafficFileVersion);
+	_lastRecord = std::chrono::steady_clock::now();
+	_recordCount = 0;
+	return _file.good();
+}
+
+void TrafficRecorder::close()
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(_file.is_open()) _file.close();
+}
+
+void TrafficRecorder::record(Direction direction, const char* data, size_t size)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(!_file.is_open() || size == 0) return;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	_file.put((char)direction);
+	writeVarint(_file, std::chrono::duration_cast<std::chrono::microseconds>(now - _lastRecord).count());
+	writeVarint(_file, size);
+	_file.write(data, size);
+	_lastRecord = now;
+	_recordCount++;
+}
+
+TrafficReader::TrafficReader()
+{
+}
+
+TrafficReader::~TrafficReader()
+{
+}
+
+bool TrafficReader::open(const std::string& filename)
+{
+	_file.open(filename, std::ios::in | std::ios::binary);
+	if(!_file.is_open()) return false;
+	char magic[sizeof(trafficFileMagic)];
+	if(!_file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), trafficFileMagic)) return false;
+	int version = _file.get();
+	return version == trafficFileVersion;
+}
+
+bool TrafficReader::readVarint(uint64_t& value)
+{
+	value = 0;
+	for(uint32_t shift = 0; shift < 64; shift += 7)
+	{
+		int byte = _file.get();
+		if(byte == std::char_traits<char>::eof()) return false;
+		value |= ((uint64_t)(byte & 0x7F)) << shift;
+		if(!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+bool TrafficReader::next(Record& record)
+{
+	int direction = _file.get();
+	if(direction == std::char_traits<char>::eof()) return false;
+	record.direction = (TrafficRecorder::Direction)direction;
+	uint64_t size = 0;
+	if(!readVarint(record.delay) || !readVarint(size) || size > maxRecordSize || (direction != (int)TrafficRecorder::Direction::sent && direction != (int)TrafficRecorder::Direction::received))
+	{
+		_truncated = true;
+		return false;
+	}
+	record.data.resize(size);
+	if(_file.read((char*)record.data.data(), size)) return true;
+	_truncated = true;
+	return false;
+}
+
+}
@@ -0,0 +1,111 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TRAFFICRECORDER_H_
+#define TRAFFICRECORDER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MyFamily
+{
+
+/**
+ * Records the raw bytes an interface sends and receives into a compact binary file.
+ *
+ * File format: The magic "HGSR", one version byte and then one record per read or write. A record is
+ * the direction byte (see Direction), the time since the previous record in microseconds (varint),
+ * the data length (varint) and the data itself. Timestamps are taken from a monotonic clock.
+ */
+class TrafficRecorder
+{
+public:
+	enum class Direction : uint8_t
+	{
+		received = 0,
+		sent = 1
+	};
+
+	TrafficRecorder();
+	virtual ~TrafficRecorder();
+
+	bool open(const std::string& filename);
+	void close();
+	void record(Direction direction, const char* data, size_t size);
+	uint64_t recordCount() { return _recordCount; }
+private:
+	std::mutex _fileMutex;
+	std::ofstream _file;
+	std::chrono::steady_clock::time_point _lastRecord;
+	uint64_t _recordCount = 0;
+};
+
+/**
+ * Reads files written by TrafficRecorder.
+ */
+class TrafficReader
+{
+public:
+	struct Record
+	{
+		TrafficRecorder::Direction direction = TrafficRecorder::Direction::received;
+		uint64_t delay = 0; //Microseconds since the previous record
+		std::vector<uint8_t> data;
+	};
+
+	TrafficReader();
+	virtual ~TrafficReader();
+
+	bool open(const std::string& filename);
+
+	/**
+	 * @return Returns false at the end of the capture or when the next record is incomplete, see truncated().
+	 */
+	bool next(Record& record);
+
+	/**
+	 * True when next() stopped at an incomplete or invalid record instead of the end of the file.
+	 */
+	bool truncated() { return _truncated; }
+private:
+	std::ifstream _file;
+	bool _truncated = false;
+
+	bool readVarint(uint64_t& value);
+};
+
+}
+
+#endif
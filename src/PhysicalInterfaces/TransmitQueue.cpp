@@ -0,0 +1,353 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "TransmitQueue.h"
+#include "../GD.h"
+
+namespace MyFamily
+{
+
+TransmitQueue::TransmitQueue(BaseLib::Output& out, Writer writer, FlushTimer flushTimer) : _out(out), _writer(writer), _flushTimer(flushTimer)
+{
+	_frameAirtime = GD::frameAirtime;
+	int32_t reserve = GD::dutyCycleReserve;
+	if(reserve < 0) reserve = 0;
+	else if(reserve > 90) reserve = 90;
+	_reservedCredit = (double)maxCredit * reserve / 100.0;
+	_creditTime = BaseLib::HelperFunctions::getTime();
+}
+
+bool TransmitQueue::send(const std::string& data, uint32_t stackPosition, bool linkOpen, std::shared_ptr<MyPacket> packet)
+{
+	try
+	{
+		Frame frame;
+		frame.data = data;
+		frame.stackPosition = stackPosition;
+		frame.time = BaseLib::HelperFunctions::getTime();
+		frame.packet = packet;
+		if(packet) frame.priority = packet->getPriority();
+
+		std::lock_guard<std::mutex> framesGuard(_framesMutex);
+		//Keep the order: Frames queued during an outage are sent first once the device is back.
+		if(!linkOpen || !_frames.empty() || creditWait(frame) > 0)
+		{
+			TransmitPriority priority = frame.priority;
+			queue(std::move(frame));
+			//A high priority frame may have been queued in front of frames held back by the budget. It doesn't wait for them.
+			if(linkOpen && priority == TransmitPriority::high && _frames.front().priority == TransmitPriority::high)
+			{
+				while(!_frames.empty() && _frames.front().priority == TransmitPriority::high && write(_frames.front())) _frames.pop_front();
+			}
+			else if(linkOpen && _frames.size() == 1) _flushTimer((int32_t)creditWait(_frames.front()));
+			return false;
+		}
+		if(!write(frame))
+		{
+			_out.printWarning("Warning: Could not send packet. Queueing it until the device is reconnected: " + data.substr(0, data.size() - 1));
+			queue(std::move(frame));
+			return false;
+		}
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+bool TransmitQueue::write(Frame& frame)
+{
+	//_framesMutex must be locked
+	if(!_writer(frame)) return false;
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	if(_frameAirtime > 0)
+	{
+		creditWait(frame); //Brings the credit up to date
+		_credit -= _frameAirtime;
+		if(_credit < 0) _credit = 0;
+	}
+	LaneStatistics& lane = _statistics.lanes[(int32_t)frame.priority];
+	int64_t latency = time - frame.time;
+	lane.sent++;
+	lane.latencySum += latency;
+	if(latency > lane.maxLatency) lane.maxLatency = latency;
+	setResult(frame, TransmitResult::sent);
+	return true;
+}
+
+TransmitQueue::Admission TransmitQueue::admit(TransmitPriority priority, bool linkOpen)
+{
+	Admission admission;
+	try
+	{
+		std::lock_guard<std::mutex> framesGuard(_framesMutex);
+		size_t framesAhead = 0;
+		for(Frame& frame : _frames)
+		{
+			if(frame.priority >= priority) framesAhead++;
+		}
+
+		if(!linkOpen)
+		{
+			admission.linkDown = true;
+			if(GD::rejectWhileDisconnected)
+			{
+				admission.result = Admission::Result::rejected;
+				admission.reason = "Device is not connected.";
+				return admission;
+			}
+			admission.result = Admission::Result::queued;
+			admission.eta = -1;
+		}
+
+		//High priority packets push out normal ones, so they are only limited by frames of their own priority.
+		size_t maxQueued = GD::maxQueuedPackets > 0 && GD::maxQueuedPackets < (int32_t)maxFrames ? GD::maxQueuedPackets : maxFrames;
+		if(framesAhead >= maxQueued)
+		{
+			admission.result = Admission::Result::rejected;
+			admission.reason = "Too many packets queued (" + std::to_string(framesAhead) + ").";
+			return admission;
+		}
+		if(!linkOpen) return admission;
+
+		int64_t eta = 0;
+		if(_frameAirtime > 0)
+		{
+			updateCredit();
+			double required = (double)_frameAirtime * (framesAhead + 1);
+			if(priority != TransmitPriority::high && _credit < _reservedCredit + required) eta = (int64_t)((_reservedCredit + required - _credit) * 100.0);
+		}
+		if(GD::maxQueueDelay > 0 && eta > GD::maxQueueDelay)
+		{
+			admission.result = Admission::Result::rejected;
+			admission.reason = "Duty cycle budget exceeded. The packet could be sent in " + std::to_string(eta / 1000) + " s.";
+			return admission;
+		}
+		admission.eta = eta;
+		admission.result = framesAhead == 0 && eta == 0 ? Admission::Result::sent : Admission::Result::queued;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return admission;
+}
+
+void TransmitQueue::updateCredit()
+{
+	//_framesMutex must be locked
+	int64_t time = BaseLib::HelperFunctions::getTime();
+	if(time > _creditTime)
+	{
+		_credit += (double)(time - _creditTime) / 100.0;
+		if(_credit > maxCredit) _credit = maxCredit;
+	}
+	_creditTime = time;
+}
+
+int64_t TransmitQueue::creditWait(const Frame& frame)
+{
+	//_framesMutex must be locked
+	if(_frameAirtime <= 0) return 0;
+	updateCredit();
+	//High priority frames are never held back by the estimate. They use up the reserve and then leave it to culfw to refuse them.
+	if(frame.priority == TransmitPriority::high) return 0;
+	double required = _reservedCredit + _frameAirtime;
+	if(_credit >= required) return 0;
+	return (int64_t)((required - _credit) * 100.0) + 1;
+}
+
+void TransmitQueue::budgetExhausted()
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	_credit = 0;
+	_creditTime = BaseLib::HelperFunctions::getTime();
+}
+
+void TransmitQueue::setResult(Frame& frame, TransmitResult result)
+{
+	//_framesMutex must be locked
+	if(result == TransmitResult::sent) _statistics.sent++;
+	else if(result == TransmitResult::superseded) _statistics.superseded++;
+	else _statistics.dropped++;
+	if(frame.packet) frame.packet->setResult(result);
+}
+
+bool TransmitQueue::supersede(Frame& frame)
+{
+	//_framesMutex must be locked
+	if(!frame.packet || frame.packet->getSupersedeGroup() == -1) return false;
+	int32_t address = frame.packet->senderAddress();
+	//Only the last frame of the remote may be replaced. Replacing an earlier one would send the rolling codes out of order, and the receiver ignores codes older than the last one it saw.
+	for(std::deque<Frame>::reverse_iterator i = _frames.rbegin(); i != _frames.rend(); ++i)
+	{
+		if(!i->packet || i->packet->senderAddress() != address || i->stackPosition != frame.stackPosition) continue;
+		//A normal priority frame must not take the place of a high priority one, e. g. a DOWN must not replace the UP of the wind protection.
+		if(i->packet->getSupersedeGroup() != frame.packet->getSupersedeGroup() || i->priority != frame.priority) return false;
+		//Commands reserve their codes in order, but concurrent ones can be queued the other way round. The frame with the newer code is kept, as the receiver would ignore the older one after it. Codes wrap at 16 bits.
+		if((int16_t)(uint16_t)(frame.packet->getRollingCode() - i->packet->getRollingCode()) < 0)
+		{
+			_out.printInfo("Info: Discarding packet " + frame.data.substr(0, frame.data.size() - 1) + ", because queued packet " + i->data.substr(0, i->data.size() - 1) + " has a newer rolling code.");
+			setResult(frame, TransmitResult::superseded);
+			return true;
+		}
+		_out.printInfo("Info: Replacing queued packet " + i->data.substr(0, i->data.size() - 1) + " with " + frame.data.substr(0, frame.data.size() - 1) + ".");
+		setResult(*i, TransmitResult::superseded);
+		*i = std::move(frame);
+		return true;
+	}
+	return false;
+}
+
+void TransmitQueue::queue(Frame&& frame)
+{
+	//_framesMutex must be locked
+	if(supersede(frame)) return;
+	if(_frames.size() >= maxFrames)
+	{
+		//Drop the oldest frame of the lowest priority queued. A frame of higher priority than the new one is never dropped for it, e. g. a normal command must not push the wind protection out. The new frame is dropped instead.
+		TransmitPriority lowest = _frames.back().priority;
+		if(lowest > frame.priority)
+		{
+			_out.printWarning("Warning: Too many packets of higher priority queued. Dropping packet: " + frame.data.substr(0, frame.data.size() - 1));
+			setResult(frame, TransmitResult::dropped);
+			return;
+		}
+		std::deque<Frame>::iterator oldest = _frames.begin();
+		while(oldest->priority != lowest) ++oldest;
+		_out.printWarning("Warning: Too many packets queued. Dropping oldest packet: " + oldest->data.substr(0, oldest->data.size() - 1));
+		setResult(*oldest, TransmitResult::dropped);
+		_frames.erase(oldest);
+	}
+
+	std::deque<Frame>::iterator position = _frames.end();
+	while(position != _frames.begin() && (position - 1)->priority < frame.priority) --position;
+	if(position != _frames.end() && frame.packet)
+	{
+		//Frames of the same remote behind the new frame would be sent with older rolling codes, which the receiver ignores.
+		int32_t address = frame.packet->senderAddress();
+		for(std::deque<Frame>::iterator i = position; i != _frames.end();)
+		{
+			if(i->packet && i->packet->senderAddress() == address && i->stackPosition == frame.stackPosition)
+			{
+				setResult(*i, TransmitResult::superseded);
+				i = _frames.erase(i);
+			}
+			else ++i;
+		}
+		position = _frames.end();
+		while(position != _frames.begin() && (position - 1)->priority < frame.priority) --position;
+	}
+	_frames.insert(position, std::move(frame));
+}
+
+void TransmitQueue::flush()
+{
+	try
+	{
+		std::lock_guard<std::mutex> framesGuard(_framesMutex);
+		if(_frames.empty()) return;
+		_out.printInfo("Info: Sending " + std::to_string(_frames.size()) + " queued packets.");
+		while(!_frames.empty())
+		{
+			Frame& frame = _frames.front();
+			if(BaseLib::HelperFunctions::getTime() - frame.time > maxFrameAge)
+			{
+				_out.printWarning("Warning: Dropping packet, because it was queued for too long: " + frame.data.substr(0, frame.data.size() - 1));
+				setResult(frame, TransmitResult::dropped);
+				_frames.pop_front();
+				continue;
+			}
+			int64_t wait = creditWait(frame);
+			if(wait > 0)
+			{
+				_flushTimer((int32_t)wait);
+				return;
+			}
+			if(!write(frame)) return; //Stays queued for the next connection
+			_frames.pop_front();
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+size_t TransmitQueue::size()
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	return _frames.size();
+}
+
+size_t TransmitQueue::clear()
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	for(Frame& frame : _frames)
+	{
+		setResult(frame, TransmitResult::dropped);
+	}
+	size_t dropped = _frames.size();
+	_frames.clear();
+	return dropped;
+}
+
+TransmitQueue::DrainResult TransmitQueue::drain(int64_t deadline, const std::function<bool()>& linkOpen)
+{
+	DrainResult result;
+	try
+	{
+		uint64_t sentBefore = getStatistics().sent;
+		while(size() > 0 && linkOpen() && BaseLib::HelperFunctions::getTime() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		result.sent = getStatistics().sent - sentBefore;
+		result.dropped = clear();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return result;
+}
+
+TransmitQueue::Statistics TransmitQueue::getStatistics()
+{
+	std::lock_guard<std::mutex> framesGuard(_framesMutex);
+	Statistics statistics = _statistics;
+	statistics.queued = _frames.size();
+	return statistics;
+}
+
+}
@@ -0,0 +1,199 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TRANSMITQUEUE_H_
+#define TRANSMITQUEUE_H_
+
+#include <homegear-base/BaseLib.h>
+#include "../MyPacket.h"
+
+#include <deque>
+#include <functional>
+
+namespace MyFamily
+{
+
+/**
+ * Frames waiting to be written to a device. Frames are written right away while the link is up. While it is down, or
+ * while older frames are still waiting, they are queued and written in order by flush() once the link is back. A queued
+ * frame is replaced by a newer one for the same remote when both packets have the same supersede group (see
+ * MyPacket::getSupersedeGroup()), so a backlog doesn't turn into a series of outdated movements. Of the two, the frame
+ * with the newer rolling code is kept.
+ *
+ * High priority frames are queued in front of normal ones. When "frameAirtime" is set in "somfy.conf", the queue also
+ * tracks culfw's 1 % duty cycle budget and holds back normal frames once only the share reserved for high priority
+ * frames ("dutyCycleReserve") is left.
+ */
+class TransmitQueue
+{
+public:
+	struct Frame
+	{
+		std::string data;
+		uint32_t stackPosition = 0;
+		TransmitPriority priority = TransmitPriority::normal;
+		int64_t time = 0;
+		std::shared_ptr<MyPacket> packet; //Receives the result. Can be empty.
+	};
+
+	struct LaneStatistics
+	{
+		uint64_t sent = 0;
+		int64_t latencySum = 0; //Milliseconds from queueing to writing, summed over all frames sent
+		int64_t maxLatency = 0;
+	};
+
+	struct Statistics
+	{
+		uint64_t sent = 0;
+		uint64_t superseded = 0;
+		uint64_t dropped = 0;
+		size_t queued = 0;
+		LaneStatistics lanes[transmitPriorityCount];
+	};
+
+	/**
+	 * Whether a packet should be handed to the interface at all, see admit().
+	 */
+	struct Admission
+	{
+		enum class Result
+		{
+			sent = 0, //Nothing is queued in front of the packet, it is sent right away
+			queued = 1, //The packet would wait in the queue for "eta" milliseconds (-1 if unknown)
+			rejected = 2 //See "reason"
+		};
+
+		Result result = Result::sent;
+		int64_t eta = 0;
+		bool linkDown = false;
+		std::string reason;
+	};
+
+	/**
+	 * Writes one frame to the device. Returns false if the frame could not be written.
+	 */
+	typedef std::function<bool(const Frame& frame)> Writer;
+
+	/**
+	 * Asks the owner to call flush() after the timeout in milliseconds. Used when frames are held back by the duty cycle
+	 * budget while the link is up.
+	 */
+	typedef std::function<void(int32_t timeout)> FlushTimer;
+
+	TransmitQueue(BaseLib::Output& out, Writer writer, FlushTimer flushTimer);
+	virtual ~TransmitQueue() = default;
+
+	/**
+	 * Writes the frame or queues it.
+	 *
+	 * @param data The frame including the line end.
+	 * @param stackPosition The stack position of the device the frame is for.
+	 * @param linkOpen Whether the device is currently available.
+	 * @param packet The packet the frame was created from. Its result is set once the frame is written, replaced or
+	 * dropped. Its priority determines the position in the queue.
+	 * @return Returns true if the frame was written, false if it was queued.
+	 */
+	bool send(const std::string& data, uint32_t stackPosition, bool linkOpen, std::shared_ptr<MyPacket> packet = std::shared_ptr<MyPacket>());
+
+	/**
+	 * Predicts what happens to a packet of the given priority sent now. Packets are rejected when the link is down and
+	 * "rejectWhileDisconnected" is set, when "maxQueuedPackets" packets are in front of it or when it would be sent later
+	 * than "maxQueueDelay" milliseconds from now.
+	 */
+	Admission admit(TransmitPriority priority, bool linkOpen);
+
+	/**
+	 * Writes the queued frames in order. Frames queued for too long are dropped. Stops at the first frame that could not
+	 * be written, which stays queued.
+	 */
+	void flush();
+
+	/**
+	 * Called when the device reported "LOVF". The budget is assumed to be used up.
+	 */
+	void budgetExhausted();
+
+	size_t size();
+
+	/**
+	 * Drops all queued frames.
+	 *
+	 * @return Returns the number of frames dropped.
+	 */
+	size_t clear();
+
+	struct DrainResult
+	{
+		uint64_t sent = 0;
+		uint64_t dropped = 0;
+	};
+
+	/**
+	 * Waits until all queued frames are written, the link is down or the deadline passed, then drops the frames left.
+	 * The frames are written by the reactor as usual, so this must not be called on the reactor thread.
+	 *
+	 * @param deadline The time (see BaseLib::HelperFunctions::getTime()) to give up waiting.
+	 * @param linkOpen Returns false when waiting is pointless, because the device is not connected.
+	 */
+	DrainResult drain(int64_t deadline, const std::function<bool()>& linkOpen);
+
+	Statistics getStatistics();
+private:
+	//Frames that could not be written are kept for this long. Older frames are dropped, as moving a blind minutes after the command was issued is worse than not moving it at all.
+	static const int64_t maxFrameAge = 30000;
+	static const size_t maxFrames = 32;
+	//culfw earns 10 ms of airtime per second (1 %) and saves up to 9 s.
+	static const int64_t maxCredit = 9000;
+
+	BaseLib::Output& _out;
+	Writer _writer;
+	FlushTimer _flushTimer;
+	std::mutex _framesMutex;
+	std::deque<Frame> _frames;
+	Statistics _statistics;
+
+	int32_t _frameAirtime = 0;
+	double _reservedCredit = 0;
+	double _credit = maxCredit;
+	int64_t _creditTime = 0;
+
+	void queue(Frame&& frame);
+	bool supersede(Frame& frame);
+	bool write(Frame& frame);
+	int64_t creditWait(const Frame& frame);
+	void updateCredit();
+	void setResult(Frame& frame, TransmitResult result);
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "RemoteAddressIndex.h"
+
+namespace MyFamily
+{
+
+bool RemoteAddressIndex::parse(const std::string& value, std::vector<int32_t>& addresses)
+{
+	addresses.clear();
+	bool valid = true;
+	std::string entry;
+	for(size_t i = 0; i <= value.size(); i++)
+	{
+		if(i < value.size() && value[i] != ',')
+		{
+			if(value[i] != ' ' && value[i] != '\t' && value[i] != '\r' && value[i] != '\n') entry.push_back(value[i]);
+			continue;
+		}
+		if(entry.empty()) continue;
+		if(entry.size() > 2 && entry[0] == '0' && (entry[1] == 'x' || entry[1] == 'X')) entry = entry.substr(2);
+		int32_t address = 0;
+		bool entryValid = !entry.empty() && entry.size() <= 6;
+		for(char c : entry)
+		{
+			if(!entryValid) break;
+			address <<= 4;
+			if(c >= '0' && c <= '9') address |= c - '0';
+			else if(c >= 'a' && c <= 'f') address |= c - 'a' + 10;
+			else if(c >= 'A' && c <= 'F') address |= c - 'A' + 10;
+			else entryValid = false;
+		}
+		if(entryValid) addresses.push_back(address);
+		else valid = false;
+		entry.clear();
+	}
+	return valid;
+}
+
+void RemoteAddressIndex::set(uint64_t peerId, const std::vector<int32_t>& addresses)
+{
+	std::lock_guard<std::mutex> indexGuard(_indexMutex);
+	removeUnlocked(peerId);
+	if(addresses.empty()) return;
+	_addressesByPeer[peerId] = addresses;
+	for(int32_t address : addresses) _peersByAddress[address].insert(peerId);
+}
+
+void RemoteAddressIndex::remove(uint64_t peerId)
+{
+	std::lock_guard<std::mutex> indexGuard(_indexMutex);
+	removeUnlocked(peerId);
+}
+
+void RemoteAddressIndex::removeUnlocked(uint64_t peerId)
+{
+	auto peerIterator = _addressesByPeer.find(peerId);
+	if(peerIterator == _addressesByPeer.end()) return;
+	for(int32_t address : peerIterator->second)
+	{
+		auto addressIterator = _peersByAddress.find(address);
+		if(addressIterator == _peersByAddress.end()) continue;
+		addressIterator->second.erase(peerId);
+		if(addressIterator->second.empty()) _peersByAddress.erase(addressIterator);
+	}
+	_addressesByPeer.erase(peerIterator);
+}
+
+std::vector<uint64_t> RemoteAddressIndex::find(int32_t address)
+{
+	std::lock_guard<std::mutex> indexGuard(_indexMutex);
+	auto addressIterator = _peersByAddress.find(address);
+	if(addressIterator == _peersByAddress.end()) return std::vector<uint64_t>();
+	return std::vector<uint64_t>(addressIterator->second.begin(), addressIterator->second.end());
+}
+
+}
@@ -0,0 +1,82 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef REMOTEADDRESSINDEX_H_
+#define REMOTEADDRESSINDEX_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace MyFamily
+{
+
+/**
+ * Maps the addresses of physical remotes to the peers they are paired with (REMOTE_ADDRESSES in the config paramset of
+ * channel 0). A physical remote has its own address, so without this its frames can't be matched to a peer.
+ */
+class RemoteAddressIndex
+{
+public:
+	RemoteAddressIndex() = default;
+	virtual ~RemoteAddressIndex() = default;
+
+	/**
+	 * Parses a comma separated list of hexadecimal 24 bit addresses, e. g. "0x1A2B3C, 1A2B3D". Whitespace is ignored.
+	 *
+	 * @return False if an entry is no valid address. "addresses" then holds the valid ones.
+	 */
+	static bool parse(const std::string& value, std::vector<int32_t>& addresses);
+
+	/**
+	 * Replaces the addresses associated with the peer.
+	 */
+	void set(uint64_t peerId, const std::vector<int32_t>& addresses);
+	void remove(uint64_t peerId);
+
+	/**
+	 * Returns the IDs of the peers the address is associated with.
+	 */
+	std::vector<uint64_t> find(int32_t address);
+private:
+	std::mutex _indexMutex;
+	std::map<int32_t, std::set<uint64_t>> _peersByAddress;
+	std::map<uint64_t, std::vector<int32_t>> _addressesByPeer;
+
+	void removeUnlocked(uint64_t peerId);
+};
+
+}
+
+#endif
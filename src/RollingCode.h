@@ -0,0 +1,108 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef ROLLINGCODE_H_
+#define ROLLINGCODE_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace MyFamily
+{
+
+/**
+ * The rolling code and encryption key of one RTS address. Both are kept in one word, so reserve() hands out a code and
+ * advances code and key in a single compare-and-swap. Concurrent commands for the same address always get different
+ * codes, without a lock on the command path.
+ */
+class RollingCode
+{
+public:
+	struct Value
+	{
+		uint16_t rollingCode = 0;
+		uint8_t encryptionKey = 0xA0;
+	};
+
+	RollingCode() = default;
+	RollingCode(const RollingCode& other) : _state(other._state.load()) {}
+	RollingCode& operator=(const RollingCode& other)
+	{
+		_state = other._state.load();
+		return *this;
+	}
+
+	Value get() const { return unpack(_state.load()); }
+
+	/**
+	 * Returns the code and key to send the next frame with and advances both.
+	 */
+	Value reserve()
+	{
+		uint32_t state = _state.load();
+		while(!_state.compare_exchange_weak(state, next(state)));
+		return unpack(state);
+	}
+
+	void setRollingCode(uint16_t rollingCode)
+	{
+		uint32_t state = _state.load();
+		while(!_state.compare_exchange_weak(state, (state & 0xFF0000) | rollingCode));
+	}
+
+	void setEncryptionKey(uint8_t encryptionKey)
+	{
+		uint32_t state = _state.load();
+		while(!_state.compare_exchange_weak(state, ((uint32_t)encryptionKey << 16) | (state & 0xFFFF)));
+	}
+private:
+	//Bits 0 to 15: rolling code, bits 16 to 23: encryption key
+	std::atomic<uint32_t> _state{0xA00000};
+
+	static Value unpack(uint32_t state)
+	{
+		Value value;
+		value.rollingCode = (uint16_t)state;
+		value.encryptionKey = (uint8_t)(state >> 16);
+		return value;
+	}
+
+	static uint32_t next(uint32_t state)
+	{
+		uint32_t rollingCode = (state + 1) & 0xFFFF;
+		uint32_t encryptionKey = (((state >> 16) & 0xAF) + 1) & 0xAF;
+		return (encryptionKey << 16) | rollingCode;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,81 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef RTSCOMMANDS_H_
+#define RTSCOMMANDS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MyFamily
+{
+
+/**
+ * Queued frames of the same remote and class replace each other, see TransmitQueue.
+ */
+enum class RtsCommandClass : uint8_t
+{
+	other = 0,
+	movement = 1,
+	prog = 2
+};
+
+struct RtsCommand
+{
+	const char* id;
+	uint8_t controlCode;
+	RtsCommandClass commandClass;
+};
+
+/**
+ * The commands of the RTS protocol, mapped to the parameter IDs in the device description. The control code is sent in
+ * the upper nibble of the frame's second byte. Adding a command only requires an entry here and a matching parameter in
+ * "Remote.xml".
+ */
+constexpr RtsCommand rtsCommands[] =
+{
+	{ "MY", 0x1, RtsCommandClass::movement },
+	{ "STOP", 0x1, RtsCommandClass::movement }, //Same code as "MY": Stops a moving motor, moves to the favourite position otherwise
+	{ "UP", 0x2, RtsCommandClass::movement },
+	{ "MY_UP", 0x3, RtsCommandClass::other },
+	{ "DOWN", 0x4, RtsCommandClass::movement },
+	{ "MY_DOWN", 0x5, RtsCommandClass::other },
+	{ "UP_DOWN", 0x6, RtsCommandClass::other },
+	{ "PROG", 0x8, RtsCommandClass::prog },
+	{ "SUN_FLAG", 0x9, RtsCommandClass::other }, //Enables sun and wind detection
+	{ "FLAG", 0xA, RtsCommandClass::other } //Disables sun detection, wind detection stays enabled
+};
+
+constexpr size_t rtsCommandCount = sizeof(rtsCommands) / sizeof(RtsCommand);
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "StrandExecutor.h"
+#include "GD.h"
+
+namespace MyFamily
+{
+
+thread_local StrandExecutor::Strand* StrandExecutor::_currentStrand = nullptr;
+thread_local int32_t StrandExecutor::_currentWorker = -1;
+
+StrandExecutor::StrandExecutor()
+{
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "Command executor: ");
+}
+
+StrandExecutor::~StrandExecutor()
+{
+	try
+	{
+		stop();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void StrandExecutor::start(uint32_t threadCount)
+{
+	try
+	{
+		stop();
+		if(threadCount == 0) threadCount = 1;
+		_stopThreads = false;
+		_workers.clear();
+		for(uint32_t i = 0; i < threadCount; i++)
+		{
+			_workers.emplace_back(new Worker());
+		}
+		for(uint32_t i = 0; i < threadCount; i++)
+		{
+			GD::bl->threadManager.start(_workers[i]->thread, false, &StrandExecutor::work, this, i);
+		}
+		{
+			std::lock_guard<std::mutex> postGuard(_postMutex);
+			_running = true;
+		}
+		_out.printInfo("Info: Processing commands with " + std::to_string(threadCount) + " threads.");
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void StrandExecutor::stop()
+{
+	try
+	{
+		{
+			//Waits for posts already past the check of _running, so everything queued is drained below.
+			std::lock_guard<std::mutex> postGuard(_postMutex);
+			if(!_running) return;
+			_running = false;
+		}
+		{
+			std::lock_guard<std::mutex> idleGuard(_idleMutex);
+			_stopThreads = true;
+		}
+		_idleConditionVariable.notify_all();
+		for(auto& worker : _workers)
+		{
+			GD::bl->threadManager.join(worker->thread);
+		}
+
+		//Tasks posted while the threads were stopping
+		for(uint32_t i = 0; i < _workers.size(); i++)
+		{
+			while(std::shared_ptr<Strand> strand = take(i))
+			{
+				runTask(i, strand);
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+bool StrandExecutor::post(const std::shared_ptr<Strand>& strand, std::function<void()> task)
+{
+	if(!strand) return false;
+	//Checking _running and queueing must not be split by stop(), or the task would be queued after the last drain.
+	std::lock_guard<std::mutex> postGuard(_postMutex);
+	if(!_running) return false;
+	{
+		std::lock_guard<std::mutex> tasksGuard(strand->_tasksMutex);
+		strand->_tasks.push_back(std::move(task));
+		if(strand->_scheduled) return true; //Runs after the tasks before it
+		strand->_scheduled = true;
+	}
+	schedule(strand);
+	return true;
+}
+
+void StrandExecutor::schedule(std::shared_ptr<Strand> strand)
+{
+	//Strands posted from a worker stay on that worker, others are spread over all workers.
+	uint32_t workerIndex = _currentWorker != -1 ? (uint32_t)_currentWorker : _nextWorker++ % _workers.size();
+	{
+		std::lock_guard<std::mutex> strandsGuard(_workers[workerIndex]->strandsMutex);
+		_workers[workerIndex]->strands.push_back(std::move(strand));
+	}
+	{
+		std::lock_guard<std::mutex> idleGuard(_idleMutex);
+		_scheduledStrands++;
+	}
+	_idleConditionVariable.notify_one();
+}
+
+std::shared_ptr<StrandExecutor::Strand> StrandExecutor::take(uint32_t workerIndex)
+{
+	for(uint32_t i = 0; i < _workers.size(); i++)
+	{
+		Worker& worker = *_workers[(workerIndex + i) % _workers.size()];
+		std::lock_guard<std::mutex> strandsGuard(worker.strandsMutex);
+		if(worker.strands.empty()) continue;
+		std::shared_ptr<Strand> strand;
+		//The own list is used from the front, others are stolen from the back.
+		if(i == 0)
+		{
+			strand = std::move(worker.strands.front());
+			worker.strands.pop_front();
+		}
+		else
+		{
+			strand = std::move(worker.strands.back());
+			worker.strands.pop_back();
+		}
+		_scheduledStrands--;
+		return strand;
+	}
+	return std::shared_ptr<Strand>();
+}
+
+void StrandExecutor::runTask(uint32_t workerIndex, std::shared_ptr<Strand> strand)
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> tasksGuard(strand->_tasksMutex);
+		task = std::move(strand->_tasks.front());
+		strand->_tasks.pop_front();
+	}
+
+	_currentStrand = strand.get();
+	try
+	{
+		task();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	_currentStrand = nullptr;
+
+	{
+		std::lock_guard<std::mutex> tasksGuard(strand->_tasksMutex);
+		if(strand->_tasks.empty())
+		{
+			strand->_scheduled = false;
+			return;
+		}
+	}
+	//One task at a time, so a busy peer doesn't hold up the others.
+	std::lock_guard<std::mutex> strandsGuard(_workers[workerIndex]->strandsMutex);
+	_workers[workerIndex]->strands.push_back(std::move(strand));
+	_scheduledStrands++;
+}
+
+void StrandExecutor::work(uint32_t workerIndex)
+{
+	_currentWorker = workerIndex;
+	while(true)
+	{
+		std::shared_ptr<Strand> strand = take(workerIndex);
+		if(strand)
+		{
+			runTask(workerIndex, strand);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> idleGuard(_idleMutex);
+		if(_stopThreads && _scheduledStrands == 0) break;
+		_idleConditionVariable.wait(idleGuard, [&] { return _scheduledStrands > 0 || _stopThreads; });
+	}
+	_currentWorker = -1;
+}
+
+}
@@ -0,0 +1,121 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef STRANDEXECUTOR_H_
+#define STRANDEXECUTOR_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+
+namespace MyFamily
+{
+
+/**
+ * Runs the commands of all peers on a small thread pool. Each peer has a strand: Tasks posted to the same strand run one
+ * after another in the order they were posted, tasks of different strands run in parallel. Every worker thread keeps its
+ * own list of strands with pending tasks. A strand stays with the worker that ran it last, idle workers steal strands
+ * from the others.
+ */
+class StrandExecutor
+{
+public:
+	class Strand
+	{
+	private:
+		friend class StrandExecutor;
+		std::mutex _tasksMutex;
+		//Every peer has a strand, but most of them are idle. Unlike a deque, an empty list doesn't allocate.
+		std::list<std::function<void()>> _tasks;
+		bool _scheduled = false; //True while the strand is in a worker's list or running
+	};
+
+	StrandExecutor();
+	virtual ~StrandExecutor();
+
+	void start(uint32_t threadCount);
+
+	/**
+	 * Waits for the tasks already posted and stops the threads. Tasks posted afterwards run on the posting thread.
+	 */
+	void stop();
+
+	/**
+	 * Queues a task. Returns false when the executor is not running. The task is not queued then.
+	 */
+	bool post(const std::shared_ptr<Strand>& strand, std::function<void()> task);
+
+	/**
+	 * Runs the task on the strand and waits for its result. When called from a task of the same strand (e. g.
+	 * putParamset calling setValue) or while the executor is stopped, the task runs right away on the calling thread.
+	 */
+	template<typename Result> Result run(const std::shared_ptr<Strand>& strand, std::function<Result()> task)
+	{
+		if(_currentStrand == strand.get()) return task();
+		auto packagedTask = std::make_shared<std::packaged_task<Result()>>(task);
+		std::future<Result> result = packagedTask->get_future();
+		if(!post(strand, [packagedTask]() { (*packagedTask)(); })) return task();
+		return result.get();
+	}
+private:
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex strandsMutex;
+		std::deque<std::shared_ptr<Strand>> strands;
+	};
+
+	static thread_local Strand* _currentStrand;
+	static thread_local int32_t _currentWorker;
+
+	BaseLib::Output _out;
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::mutex _postMutex;
+	std::atomic_bool _running{false};
+	std::atomic_bool _stopThreads{false};
+	std::atomic<uint32_t> _nextWorker{0};
+	std::atomic<int32_t> _scheduledStrands{0}; //Can briefly be negative while a strand is taken before it was counted
+	std::mutex _idleMutex;
+	std::condition_variable _idleConditionVariable;
+
+	void schedule(std::shared_ptr<Strand> strand);
+	std::shared_ptr<Strand> take(uint32_t workerIndex);
+	void runTask(uint32_t workerIndex, std::shared_ptr<Strand> strand);
+	void work(uint32_t workerIndex);
+};
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Test.h"
+#include "../src/InterfaceSelector.h"
+#include "../src/RemoteAddressIndex.h"
+
+namespace MyFamily
+{
+
+namespace
+{
+
+//Routes a received frame like MyCentral::processPacket() does for physical remotes: to every peer the address is associated with.
+void receive(RemoteAddressIndex& index, std::map<uint64_t, InterfaceSelector>& selectors, int32_t address, const std::string& interfaceId, int32_t rssi, int64_t time)
+{
+	for(uint64_t peerId : index.find(address))
+	{
+		selectors[peerId].rssiReceived(interfaceId, rssi, time);
+	}
+}
+
+bool usable(const std::string& interfaceId)
+{
+	return true;
+}
+
+}
+
+TEST(InterfaceSelectionFollowsPairedRemote)
+{
+	RemoteAddressIndex index;
+	std::vector<int32_t> addresses;
+	CHECK(RemoteAddressIndex::parse("0x1A2B3C", addresses));
+	index.set(1, addresses);
+	std::map<uint64_t, InterfaceSelector> selectors;
+	int64_t time = 1000000;
+
+	//The peer sends with its own address, which is never received. Without the paired remote there is nothing to select by.
+	CHECK(selectors[1].select("CUL-A", true, usable, time, 6).interfaceId.empty());
+
+	//The paired remote is heard badly by the current interface and well by the other one.
+	for(int32_t i = 0; i < 3; i++)
+	{
+		receive(index, selectors, 0x1A2B3C, "CUL-A", -90, time + i);
+		receive(index, selectors, 0x1A2B3C, "CUL-B", -60, time + i);
+	}
+	InterfaceSelector::Selection selection = selectors[1].select("CUL-A", true, usable, time + 10, 6);
+	CHECK(selection.interfaceId == "CUL-B");
+	CHECK(selection.currentKnown);
+	CHECK(selection.rssi == -60);
+	CHECK(selection.currentRssi == -90);
+}
+
+TEST(InterfaceSelectionIgnoresUnpairedRemote)
+{
+	RemoteAddressIndex index;
+	index.set(1, std::vector<int32_t>{ 0x1A2B3C });
+	std::map<uint64_t, InterfaceSelector> selectors;
+	int64_t time = 1000000;
+
+	for(int32_t i = 0; i < 3; i++)
+	{
+		receive(index, selectors, 0x1A2B3C, "CUL-A", -90, time + i);
+		receive(index, selectors, 0x1A2B3D, "CUL-B", -60, time + i);
+	}
+	CHECK(selectors[1].getStatistics().size() == 1);
+	CHECK(selectors[1].select("CUL-A", true, usable, time + 10, 6).interfaceId.empty());
+
+	//Once the association is removed, the remote no longer counts.
+	index.remove(1);
+	CHECK(index.find(0x1A2B3C).empty());
+}
+
+TEST(InterfaceSelectionKeepsInterfaceWithinMargin)
+{
+	InterfaceSelector selector;
+	int64_t time = 1000000;
+	for(int32_t i = 0; i < 3; i++)
+	{
+		selector.rssiReceived("CUL-A", -70, time + i);
+		selector.rssiReceived("CUL-B", -66, time + i);
+	}
+	CHECK(selector.select("CUL-A", true, usable, time + 10, 6).interfaceId.empty());
+	//A failed interface is left even without a margin, frames received by it don't matter.
+	CHECK(selector.select("CUL-A", false, [](const std::string& interfaceId) { return interfaceId != "CUL-A"; }, time + 10, 6).interfaceId == "CUL-B");
+	//Too old frames don't count.
+	CHECK(selector.select("CUL-A", false, usable, time + InterfaceSelector::maxFrameAge + 10, 6).interfaceId.empty());
+}
+
+TEST(RemoteAddressesAreParsed)
+{
+	std::vector<int32_t> addresses;
+	CHECK(RemoteAddressIndex::parse("", addresses));
+	CHECK(addresses.empty());
+	CHECK(RemoteAddressIndex::parse(" 0x1A2B3C, 1a2b3d ,,FFFFFF", addresses));
+	CHECK(addresses.size() == 3);
+	CHECK(addresses.at(0) == 0x1A2B3C);
+	CHECK(addresses.at(1) == 0x1A2B3D);
+	CHECK(addresses.at(2) == 0xFFFFFF);
+	//Invalid entries are reported, the valid ones are still used.
+	CHECK(!RemoteAddressIndex::parse("1000000, 0x, 12G456, 123456", addresses));
+	CHECK(addresses.size() == 1);
+	CHECK(addresses.at(0) == 0x123456);
+}
+
+}
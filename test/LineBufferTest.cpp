@@ -0,0 +1,101 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Test.h"
+#include "../src/PhysicalInterfaces/LineBuffer.h"
+
+namespace MyFamily
+{
+
+namespace
+{
+
+std::vector<std::string> append(LineBuffer& buffer, const std::string& chunk, size_t* discarded = nullptr)
+{
+	std::vector<std::string> lines;
+	size_t bytes = buffer.append(chunk.data(), chunk.size(), [&](const char* line, size_t length) { lines.emplace_back(line, length); });
+	if(discarded) *discarded = bytes;
+	return lines;
+}
+
+}
+
+TEST(LineBufferJoinsFrameSplitAcrossChunks)
+{
+	LineBuffer buffer(1024);
+	//A frame as received by culfw with "X21", split by the read in the middle of the frame.
+	CHECK(append(buffer, "YsA0B1C2").empty());
+	CHECK(buffer.size() == 8);
+	std::vector<std::string> lines = append(buffer, "D3E4F5A6B7\r\nV 1.67");
+	CHECK(lines.size() == 1);
+	CHECK(lines.at(0) == "YsA0B1C2D3E4F5A6B7");
+
+	//The line end itself can be split, too.
+	CHECK(append(buffer, " CUL868\r").empty());
+	lines = append(buffer, "\n");
+	CHECK(lines.size() == 1);
+	CHECK(lines.at(0) == "V 1.67 CUL868");
+	CHECK(buffer.size() == 0);
+}
+
+TEST(LineBufferSplitsChunkWithSeveralLines)
+{
+	LineBuffer buffer(1024);
+	std::vector<std::string> lines = append(buffer, "LOVF\n\n*YsA0B1C2D3E4F5A6B7\nYs");
+	CHECK(lines.size() == 3);
+	CHECK(lines.at(0) == "LOVF");
+	CHECK(lines.at(1).empty());
+	CHECK(lines.at(2) == "*YsA0B1C2D3E4F5A6B7");
+	CHECK(buffer.size() == 2);
+}
+
+TEST(LineBufferDiscardsLineWithoutEnd)
+{
+	LineBuffer buffer(16);
+	size_t discarded = 0;
+	CHECK(append(buffer, "0123456789", &discarded).empty());
+	CHECK(discarded == 0);
+	CHECK(append(buffer, "0123456789", &discarded).empty());
+	CHECK(discarded == 20);
+	CHECK(buffer.size() == 0);
+
+	//The next line is received as usual.
+	std::vector<std::string> lines = append(buffer, "V 1.67\n", &discarded);
+	CHECK(discarded == 0);
+	CHECK(lines.size() == 1 && lines.at(0) == "V 1.67");
+
+	buffer.append("partial", 7, [](const char* line, size_t length) {});
+	buffer.clear();
+	lines = append(buffer, "\n");
+	CHECK(lines.size() == 1 && lines.at(0).empty());
+}
+
+}
@@ -0,0 +1,73 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace MyFamily
+{
+
+/**
+ * A minimal test runner, so the tests need nothing but the libraries the module links anyway. Tests are defined with
+ * TEST() and fail with the first CHECK() that doesn't hold.
+ */
+class Test
+{
+public:
+	struct Failure : public std::runtime_error
+	{
+		Failure(const char* file, int line, const char* condition) : std::runtime_error(std::string(file) + ":" + std::to_string(line) + ": CHECK(" + condition + ") failed.") {}
+	};
+
+	struct Registration
+	{
+		Registration(const char* name, std::function<void()> test) { tests().emplace_back(name, test); }
+	};
+
+	static std::vector<std::pair<std::string, std::function<void()>>>& tests()
+	{
+		static std::vector<std::pair<std::string, std::function<void()>>> tests;
+		return tests;
+	}
+};
+
+}
+
+#define TEST(name) static void name(); static MyFamily::Test::Registration name##Registration(#name, &name); static void name()
+#define CHECK(condition) do { if(!(condition)) throw MyFamily::Test::Failure(__FILE__, __LINE__, #condition); } while(false)
+
+#endif
@@ -0,0 +1,160 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Test.h"
+#include "../src/PhysicalInterfaces/TransmitQueue.h"
+
+namespace MyFamily
+{
+
+namespace
+{
+
+std::shared_ptr<MyPacket> createPacket(int32_t address, TransmitPriority priority)
+{
+	std::shared_ptr<MyPacket> packet = std::make_shared<MyPacket>();
+	packet->setSenderAddress(address);
+	packet->setPriority(priority);
+	return packet;
+}
+
+std::shared_ptr<MyPacket> createMovement(int32_t address, uint16_t rollingCode)
+{
+	std::shared_ptr<MyPacket> packet = createPacket(address, TransmitPriority::normal);
+	packet->setRollingCode(rollingCode);
+	packet->setSupersedeGroup(0);
+	return packet;
+}
+
+bool isReady(const std::shared_ptr<MyPacket>& packet)
+{
+	return packet->getResult().wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}
+
+TEST(TransmitQueueDropsNewFrameWhenFullOfHigherPriority)
+{
+	BaseLib::Output out;
+	std::vector<std::string> written;
+	TransmitQueue queue(out, [&](const TransmitQueue::Frame& frame) { written.push_back(frame.data); return true; }, [](int32_t timeout) {});
+
+	//The link is down, so everything is queued.
+	std::vector<std::shared_ptr<MyPacket>> highPackets;
+	for(int32_t i = 0; i < 32; i++)
+	{
+		highPackets.push_back(createPacket(0x100000 + i, TransmitPriority::high));
+		queue.send("YsHigh" + std::to_string(i) + "\n", 0, false, highPackets.back());
+	}
+	CHECK(queue.size() == 32);
+
+	std::shared_ptr<MyPacket> normalPacket = createPacket(0x200000, TransmitPriority::normal);
+	queue.send("YsNormal\n", 0, false, normalPacket);
+	CHECK(queue.size() == 32);
+	CHECK(isReady(normalPacket) && normalPacket->getResult().get() == TransmitResult::dropped);
+	CHECK(queue.getStatistics().dropped == 1);
+	for(auto& packet : highPackets)
+	{
+		CHECK(!isReady(packet));
+	}
+
+	queue.flush();
+	CHECK(written.size() == 32);
+	CHECK(written.front() == "YsHigh0\n");
+	CHECK(written.back() == "YsHigh31\n");
+}
+
+TEST(TransmitQueueKeepsFrameWithNewerRollingCode)
+{
+	BaseLib::Output out;
+	std::vector<std::string> written;
+	TransmitQueue queue(out, [&](const TransmitQueue::Frame& frame) { written.push_back(frame.data); return true; }, [](int32_t timeout) {});
+
+	//Queued in order: the newer frame replaces the older one.
+	std::shared_ptr<MyPacket> first = createMovement(0x100000, 10);
+	std::shared_ptr<MyPacket> second = createMovement(0x100000, 11);
+	queue.send("YsCode10\n", 0, false, first);
+	queue.send("YsCode11\n", 0, false, second);
+	CHECK(queue.size() == 1);
+	CHECK(isReady(first) && first->getResult().get() == TransmitResult::superseded);
+
+	//Queued the other way round, e. g. by two concurrent commands: the older frame must not replace the newer one.
+	std::shared_ptr<MyPacket> late = createMovement(0x100000, 9);
+	queue.send("YsCode9\n", 0, false, late);
+	CHECK(queue.size() == 1);
+	CHECK(isReady(late) && late->getResult().get() == TransmitResult::superseded);
+	CHECK(!isReady(second));
+
+	//The code wraps at 16 bits, so 0 is newer than 0xFFFF.
+	std::shared_ptr<MyPacket> beforeWrap = createMovement(0x200000, 0xFFFF);
+	std::shared_ptr<MyPacket> afterWrap = createMovement(0x200000, 0);
+	queue.send("YsCode0000\n", 0, false, afterWrap);
+	queue.send("YsCodeFFFF\n", 0, false, beforeWrap);
+	CHECK(isReady(beforeWrap) && beforeWrap->getResult().get() == TransmitResult::superseded);
+	CHECK(!isReady(afterWrap));
+
+	queue.flush();
+	CHECK(written.size() == 2);
+	CHECK(written.front() == "YsCode11\n");
+}
+
+TEST(TransmitQueueDropsOldestFrameOfLowestPriorityWhenFull)
+{
+	BaseLib::Output out;
+	TransmitQueue queue(out, [](const TransmitQueue::Frame& frame) { return true; }, [](int32_t timeout) {});
+
+	std::shared_ptr<MyPacket> highPacket = createPacket(0x100000, TransmitPriority::high);
+	queue.send("YsHigh\n", 0, false, highPacket);
+	std::vector<std::shared_ptr<MyPacket>> normalPackets;
+	for(int32_t i = 0; i < 31; i++)
+	{
+		normalPackets.push_back(createPacket(0x200000 + i, TransmitPriority::normal));
+		queue.send("YsNormal" + std::to_string(i) + "\n", 0, false, normalPackets.back());
+	}
+
+	//A new high priority frame pushes out the oldest normal one.
+	std::shared_ptr<MyPacket> newHighPacket = createPacket(0x300000, TransmitPriority::high);
+	queue.send("YsHigh2\n", 0, false, newHighPacket);
+	CHECK(queue.size() == 32);
+	CHECK(isReady(normalPackets.front()) && normalPackets.front()->getResult().get() == TransmitResult::dropped);
+	CHECK(!isReady(highPacket));
+	CHECK(!isReady(newHighPacket));
+
+	//So does a new normal frame.
+	std::shared_ptr<MyPacket> newNormalPacket = createPacket(0x400000, TransmitPriority::normal);
+	queue.send("YsNormal31\n", 0, false, newNormalPacket);
+	CHECK(queue.size() == 32);
+	CHECK(isReady(normalPackets.at(1)) && normalPackets.at(1)->getResult().get() == TransmitResult::dropped);
+	CHECK(!isReady(newNormalPacket));
+	CHECK(queue.getStatistics().dropped == 2);
+}
+
+}
@@ -0,0 +1,59 @@
+/* Copyright 2013-2019 Homegear GmbH
+ * Copyright 2021 Andreas Boehler
+ * Copyright 2023 Jan-Martin Raemer
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "Test.h"
+
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+	//An argument runs only the tests containing it in their name.
+	std::string filter = argc > 1 ? argv[1] : "";
+	int32_t failed = 0;
+	int32_t run = 0;
+	for(auto& test : MyFamily::Test::tests())
+	{
+		if(!filter.empty() && test.first.find(filter) == std::string::npos) continue;
+		run++;
+		try
+		{
+			test.second();
+			std::cout << "Passed: " << test.first << std::endl;
+		}
+		catch(const std::exception& ex)
+		{
+			failed++;
+			std::cout << "Failed: " << test.first << ": " << ex.what() << std::endl;
+		}
+	}
+	std::cout << std::endl << (run - failed) << " of " << run << " tests passed." << std::endl;
+	return failed == 0 ? 0 : 1;
+}